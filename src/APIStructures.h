@@ -142,7 +142,8 @@ typedef struct
 {
 	unsigned long
 		ulFlags,
-		ulFrameNumber;
+		ulFrameNumber,
+		ulStatus;		/* raw port handle status word from the last reply */
 	QuatRotation
 		rotation;
 	Position3d
@@ -216,6 +217,7 @@ typedef struct
 		nNoFGCards,
 		nNoFGs;
 	/* TRACKING INFORMATION */
+	unsigned int uSystemStatus;		/* raw system status word from the last reply */
 	int	bCommunicationSyncError;
 	int bTooMuchInterference;
 	int bSystemCRCError;
@@ -41,10 +41,12 @@ CCommandHandling::CCommandHandling()
 	m_bDisplayErrorsWhileTracking = false;
 
 	m_nRefHandle = -1;
+	m_nLastReplyLength = 0;
 
 	m_nTimeout = 3;
 	m_nDefaultTimeout = 10;
 	waitForResponse = 500;
+	m_nReadTimeout = DEFAULT_READ_TIMEOUT;
 
 } /* CCommandHandling()
 
@@ -590,6 +592,8 @@ int CCommandHandling::nGetResponse()
 {
 	char
 		chChar;
+	int
+		charInt = 0;
 
 	bool bDone = FALSE;
 	int 
@@ -608,10 +612,15 @@ int CCommandHandling::nGetResponse()
 			return FALSE;
 		}/* if */
 
-        chChar = pCOMPort->SerialGetChar();
+		charInt = pCOMPort->SerialGetChar( m_nReadTimeout );
 
-		// Check for error
-		if( chChar == NULL ) return false;
+		// Check for error, before it is truncated to a char
+		if( charInt == SERIAL_READ_ERROR ) return 0;
+
+		chChar = char(charInt);
+
+		/* don't run off the end of the reply buffer if the line is garbage */
+		if ( nCount >= MAX_REPLY_MSG - 2 ) return 0;
 
 		/* if carriage return, we are done */
 		if ( chChar == '\r' )
@@ -636,7 +645,8 @@ int CCommandHandling::nGetResponse()
 Name:				nActivateAllPorts
 
 Inputs:
-	None.
+	bool bDeferPortInformation - leave the PHINF calls until after
+								 tracking has started
 
 Return Value:
 	int - 1 if successful, 0 otherwise
@@ -644,20 +654,56 @@ Return Value:
 Description:    This is the routine that activates all ports using
 				
 *****************************************************************/
-int CCommandHandling::nActivateAllPorts()
+int CCommandHandling::nActivateAllPorts( bool bDeferPortInformation )
 {
 	if (!nFreePortHandles())
 		return 0;
 
-	if (!nInitializeAllPorts())
+	if (!nInitializeAllPorts( bDeferPortInformation ))
 		return 0;
 
-	if (!nEnableAllPorts())
+	if (!nEnableAllPorts( bDeferPortInformation ))
+		return 0;
+
+	if (!nGetEnabledPortHandles())
 		return 0;
 
 	return 1;
 } /* nActivateAllPorts */
 
+/*****************************************************************
+Name:				nActivateNewPorts
+
+Inputs:
+	bool bDeferPortInformation - leave the PHINF calls for later
+
+Return Value:
+	int - 1 if successful, 0 otherwise
+
+Description:    This routine frees the handles of tools that have
+				been unplugged and initializes and enables the
+				handles of tools that have been plugged in.  Only
+				the handles reported by PHSR are touched so it can
+				be called while tracking without disturbing the
+				tools that are already enabled.
+*****************************************************************/
+int CCommandHandling::nActivateNewPorts( bool bDeferPortInformation )
+{
+	if (!nFreePortHandles())
+		return 0;
+
+	if (!nInitializeAllPorts( bDeferPortInformation ))
+		return 0;
+
+	if (!nEnableAllPorts( bDeferPortInformation ))
+		return 0;
+
+	if (!nGetEnabledPortHandles())
+		return 0;
+
+	return 1;
+} /* nActivateNewPorts */
+
 int CCommandHandling::nFreePortHandles()
 {
 	int
@@ -695,6 +741,8 @@ int CCommandHandling::nFreePortHandles()
 				return 0;
 			m_dtHandleInformation[nHandle].HandleInfo.bInitialized = FALSE;
 			m_dtHandleInformation[nHandle].HandleInfo.bEnabled = FALSE;
+			PendingPortInformation.erase( std::remove( PendingPortInformation.begin(), PendingPortInformation.end(), nHandle ),
+										  PendingPortInformation.end() );
 			/* EC-03-0071 */
 			memset(m_dtHandleInformation[nHandle].szPhysicalPort, 0, 5);
 		} /* for */
@@ -708,7 +756,9 @@ int CCommandHandling::nFreePortHandles()
 Name:				nInitializeAllPorts
 
 Inputs:
-	None.
+	bool bDeferPortInformation - skip the PHINF before each PINIT,
+								 PHSR 02 only lists handles that
+								 still need initializing
 
 Return Value:
 	int - 1 is successful, 0 otherwise
@@ -717,7 +767,7 @@ Description:   This routine intializes all the ports using the
 			   PINIT call.  It also makes calls to the PVWR routine
 			   and TTCFG routine to virtual load tool definitions.
 *****************************************************************/
-int CCommandHandling::nInitializeAllPorts()
+int CCommandHandling::nInitializeAllPorts( bool bDeferPortInformation )
 {
 	int
 		i = 0,
@@ -771,10 +821,10 @@ int CCommandHandling::nInitializeAllPorts()
 			for ( int i = 0; i < nNoHandles; i++ )
 			{
 				nHandle = uASCIIToHex( &szHandleList[n], 2 );
-				if ( !nGetPortInformation( nHandle ) )
+				if ( !bDeferPortInformation && !nGetPortInformation( nHandle ) )
 					return 0;
 
-				if ( !m_dtHandleInformation[nHandle].HandleInfo.bInitialized )
+				if ( bDeferPortInformation || !m_dtHandleInformation[nHandle].HandleInfo.bInitialized )
 				{
 					if (!nInitializeHandle( nHandle ))
 					{
@@ -807,7 +857,9 @@ int CCommandHandling::nInitializeAllPorts()
 Name:				nEnableAllPorts
 
 Inputs:
-	None.
+	bool bDeferPortInformation - queue the handles in
+								 PendingPortInformation instead of
+								 calling PHINF for each one
 
 Return Value:
 	int - 1 if successful, 0 otherwise
@@ -815,7 +867,7 @@ Return Value:
 Description:   This routine enables all the port handles that need
 			   to be enabled using the PENA command.
 *****************************************************************/
-int CCommandHandling::nEnableAllPorts()
+int CCommandHandling::nEnableAllPorts( bool bDeferPortInformation )
 {
 	int
 		nNoHandles = 0,
@@ -853,7 +905,10 @@ int CCommandHandling::nEnableAllPorts()
 				return 0;
 			if (!nCheckResponse(nVerifyResponse(m_szLastReply, TRUE )))
 				return 0;
-			nGetPortInformation( nPortHandle );
+			if ( bDeferPortInformation )
+				PendingPortInformation.push_back( nPortHandle );
+			else
+				nGetPortInformation( nPortHandle );
 			m_nPortsEnabled++;
 		} /* for */
 		return 1;
@@ -861,6 +916,53 @@ int CCommandHandling::nEnableAllPorts()
 	return 0;
 } /* nEnableAllPorts */
 
+/*****************************************************************
+Name:				nGetEnabledPortHandles
+
+Inputs:
+	None.
+
+Return Value:
+	int - 1 if successful, 0 otherwise
+
+Description:   This routine gets the list of all the enabled port
+			   handles using the PHSR 04 command and stores it in
+			   EnabledPortHandles.
+*****************************************************************/
+int CCommandHandling::nGetEnabledPortHandles()
+{
+	int
+		nNoHandles = 0,
+		n = 0;
+
+	memset(m_szCommand, 0, sizeof(m_szCommand));
+	sprintf( m_szCommand, "PHSR 04" );
+
+	if(nSendMessage( m_szCommand, TRUE ))
+	{
+		if (!nGetResponse( ))
+			return 0;
+
+		if (!nCheckResponse(nVerifyResponse(m_szLastReply, TRUE )))
+			return 0;
+
+		EnabledPortHandles.clear();
+
+		nNoHandles = uASCIIToHex( &m_szLastReply[n], 2 );
+		n+=2;
+
+		for ( int i = 0; i < nNoHandles; i++ )
+		{
+			EnabledPortHandles.push_back( uASCIIToHex( &m_szLastReply[n], 2 ) );
+			n+=5;
+		} /* for */
+
+		m_nPortsEnabled = EnabledPortHandles.size();
+		return 1;
+	} /* if */
+	return 0;
+} /* nGetEnabledPortHandles */
+
 /*****************************************************************
 Name:				nInitializeHandle
 
@@ -986,6 +1088,10 @@ int CCommandHandling::nGetPortInformation(int nPortHandle)
 					} /* for */
 				} /* if */
 			} /* if */
+
+			/* no longer waiting on this handle's information */
+			PendingPortInformation.erase( std::remove( PendingPortInformation.begin(), PendingPortInformation.end(), nPortHandle ),
+										  PendingPortInformation.end() );
 		} /* if */
 		else
 			return 0;
@@ -1055,8 +1161,8 @@ int CCommandHandling::nGetBXTransforms(bool bReturn0x0800Option)
 		pszTransformInfo = m_szLastReply;
 		uCalcCRC = SystemGetCRC(m_szLastReply, 4 );
 
-		/* check for preamble ( A5C4 ) */
-        while(((pszTransformInfo[0]&0xff)!=0xc4))
+		/* check for preamble ( A5C4 ), without leaving the reply buffer */
+        while(((pszTransformInfo[0]&0xff)!=0xc4) && pszTransformInfo < &m_szLastReply[MAX_REPLY_MSG-7])
 		{
             pszTransformInfo++;
 		}/* while */
@@ -1120,6 +1226,7 @@ int CCommandHandling::nGetBXTransforms(bool bReturn0x0800Option)
 				m_dtHandleInformation[nHandle].Xfrms.ulFrameNumber = nGetHex4(&pszTransformInfo[nSpot]);
 				nSpot+=4;
 				m_dtHandleInformation[nHandle].Xfrms.ulFlags = TRANSFORM_VALID;
+				m_dtHandleInformation[nHandle].Xfrms.ulStatus = unHandleStatus;
 			} /* if */
 
 			if ( uTransStatus == 2 || uTransStatus == 4 ) /* 2 means the tool is missing and */
@@ -1136,9 +1243,13 @@ int CCommandHandling::nGetBXTransforms(bool bReturn0x0800Option)
 					m_dtHandleInformation[nHandle].Xfrms.ulFrameNumber = nGetHex4(&pszTransformInfo[nSpot]);
 					nSpot+=4;
 					m_dtHandleInformation[nHandle].Xfrms.ulFlags = TRANSFORM_MISSING;
+					m_dtHandleInformation[nHandle].Xfrms.ulStatus = unHandleStatus;
 				} /* if */
 				else
+				{
 					m_dtHandleInformation[nHandle].Xfrms.ulFlags = TRANSFORM_DISABLED;
+					m_dtHandleInformation[nHandle].Xfrms.ulStatus = 0;
+				} /* else */
 
 				m_dtHandleInformation[nHandle].Xfrms.rotation.q0 =
 				m_dtHandleInformation[nHandle].Xfrms.rotation.qx =
@@ -1172,6 +1283,7 @@ int CCommandHandling::nGetBXTransforms(bool bReturn0x0800Option)
 		unSystemStatus = nGetHex2( &pszTransformInfo[nSpot] );
 		nSpot+=2;
 		uBodyCRC = nGetHex2(&pszTransformInfo[nSpot]); 
+		m_dtSystemInformation.uSystemStatus = unSystemStatus;
 		m_dtSystemInformation.bCommunicationSyncError = ( unSystemStatus & 0x01 ? 1 : 0 );
 		m_dtSystemInformation.bTooMuchInterference = ( unSystemStatus & 0x02 ? 1 : 0 );
 		m_dtSystemInformation.bSystemCRCError = ( unSystemStatus & 0x04 ? 1 : 0 );
@@ -1244,11 +1356,14 @@ int CCommandHandling::nGetBinaryResponse( )
 			return FALSE;
 		}/* if */
 
-		charInt = pCOMPort->SerialGetChar();
+		charInt = pCOMPort->SerialGetChar( m_nReadTimeout );
 		
 		// Check for an error
 		if( charInt ==  SERIAL_READ_ERROR ) break;
 
+		/* a corrupt length field must not run off the end of the reply buffer */
+		if ( nCount >= MAX_REPLY_MSG - 1 ) break;
+
 		chChar = char(charInt);
 		m_szLastReply[nCount] = chChar;
 
@@ -1270,6 +1385,8 @@ int CCommandHandling::nGetBinaryResponse( )
 
 	} while ( !bDone );
 
+	m_nLastReplyLength = bDone ? nCount : 0;
+
 	return bDone;
 
 } /* nGetBinaryResponse */
@@ -1329,4 +1446,61 @@ int CCommandHandling::nStopTracking()
 int CCommandHandling::GetNumEnabledHandles()
 {
 	return m_nPortsEnabled;
-}
\ No newline at end of file
+}
+
+/*****************************************************************
+Name:				setReadTimeout
+
+Inputs:
+	unsigned int msTimeout - milliseconds to wait for each character
+
+Return Value:
+	None.
+
+Description:   Sets how long nGetResponse and nGetBinaryResponse
+			   wait for each character of a reply.  A short timeout
+			   while tracking lets a lost link be noticed within a
+			   few frames instead of after seconds.
+*****************************************************************/
+void CCommandHandling::setReadTimeout( unsigned int msTimeout )
+{
+	m_nReadTimeout = msTimeout;
+} /* setReadTimeout */
+
+/*****************************************************************
+Name:				nResyncComPort
+
+Inputs:
+	None.
+
+Return Value:
+	int - 1 if successful, 0 otherwise
+
+Description:   Discards any partial reply still arriving on the
+			   COM port so the next command starts on a reply
+			   boundary.  The port is flushed, given one read
+			   timeout for any bytes in flight, then flushed again.
+			   The drain stops after at most one reply's worth of
+			   bytes or RESYNC_DRAIN_TIMEOUTS read timeouts, so a
+			   device that keeps sending can't hold it up.
+*****************************************************************/
+int CCommandHandling::nResyncComPort()
+{
+	/* Check COM port */
+	if( pCOMPort == NULL )
+		return 0;
+
+	if ( !pCOMPort->SerialFlush() )
+		return 0;
+
+	/* drain whatever was still on the wire, bounded in bytes and time */
+	boost::chrono::steady_clock::time_point deadline = boost::chrono::steady_clock::now() +
+		boost::chrono::milliseconds( RESYNC_DRAIN_TIMEOUTS * m_nReadTimeout );
+	int nDrained = 0;
+
+	while ( nDrained < MAX_REPLY_MSG && boost::chrono::steady_clock::now() < deadline &&
+			pCOMPort->SerialGetChar( m_nReadTimeout ) != SERIAL_READ_ERROR )
+		++nDrained;
+
+	return pCOMPort->SerialFlush();
+} /* nResyncComPort */
\ No newline at end of file
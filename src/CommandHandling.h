@@ -66,6 +66,9 @@ Defines
 #define VICRA_SYSTEM		4	/* or VICRA */
 #define SPECTRA_SYSTEM	    5	/* or SPECTRA */
 
+#define DEFAULT_READ_TIMEOUT	3000	/* milliseconds to wait for each reply character */
+#define RESYNC_DRAIN_TIMEOUTS	4	/* read timeouts nResyncComPort drains for at most */
+
 /*****************************************************************
 Structures
 *****************************************************************/
@@ -102,12 +105,14 @@ public:
 	int nInitializeSystem();
 	int nSetFiringRate();
 	int nGetSystemInfo();
-	int nInitializeAllPorts();
+	int nInitializeAllPorts( bool bDeferPortInformation = false );
 	int nInitializeHandle( int nHandle );
-	int nEnableAllPorts();
+	int nEnableAllPorts( bool bDeferPortInformation = false );
 	int nEnableOnePorts( int nPortHandle );
 	int nDisablePort( int nPortHandle );
-	int nActivateAllPorts();
+	int nActivateAllPorts( bool bDeferPortInformation = false );
+	int nActivateNewPorts( bool bDeferPortInformation = false );
+	int nGetEnabledPortHandles();
 	int nLoadTTCFG( char * pszPortID );
 	int nGetHandleForPort( char * pszPortID );
 	int nLoadVirtualSROM( char * pszFileName, 
@@ -128,6 +133,9 @@ public:
 
 	int GetNumEnabledHandles();
 
+	void setReadTimeout( unsigned int msTimeout );
+	int nResyncComPort();
+
 /*****************************************************************
 Variables
 *****************************************************************/
@@ -144,12 +152,15 @@ Variables
 		m_dtHandleInformation[NO_HANDLES];	/* Handle Information varaible - structure */
 
 	int
-		m_nRefHandle; /* the handle for the tool acting as the reference tool */
+		m_nRefHandle, /* the handle for the tool acting as the reference tool */
+		m_nLastReplyLength; /* bytes in the last binary reply, 0 if it failed */
 
 	DiagNewAlertFlags
 		m_dtNewAlerts; /* alert information */
 
 	std::vector<int> ActivatedPortHandles;
+	std::vector<int> EnabledPortHandles;	// Handles reported as enabled by the last PHSR 04
+	std::vector<int> PendingPortInformation;	// Enabled handles whose PHINF has been deferred
 
 	//CMap<CString, LPCTSTR, int, int>
 	//	m_dtTimeoutValues;
@@ -200,5 +211,7 @@ Variables
 		m_nPortsEnabled;				/* the number of port enable by nEnableAllPorts */
 
 	int waitForResponse;		// Number of milliseconds to wait for a response
+
+	unsigned int m_nReadTimeout;	// Number of milliseconds to wait for each reply character
 };
 /************************END OF FILE*****************************/
@@ -611,4 +611,121 @@ void QuatCombineXfrms( QuatTransformation *pdtXfrm12,
     pdtXfrm13->translation.y += pdtXfrm23->translation.y;
     pdtXfrm13->translation.z += pdtXfrm23->translation.z;
 } /* QuatCombineXfrms */
+
+/*****************************************************************
+Name:            QuatNormalize
+
+Input Values:
+    QuatRotation
+       *pdtQuatRot          : quaternion to normalize
+
+Output Values:
+    The quaternion pointed to by pdtQuatRot is scaled to unit
+    length.
+
+Returned Value:
+    None
+
+Description:
+    This routine scales the given quaternion to unit length.  A
+    zero quaternion is set to the identity rotation.
+*****************************************************************/
+void QuatNormalize( QuatRotation *pdtQuatRot )
+{
+    double
+        dLength;
+
+    dLength = sqrt( (double)pdtQuatRot->q0 * pdtQuatRot->q0
+                  + (double)pdtQuatRot->qx * pdtQuatRot->qx
+                  + (double)pdtQuatRot->qy * pdtQuatRot->qy
+                  + (double)pdtQuatRot->qz * pdtQuatRot->qz );
+
+    if( dLength <= 0.0 )
+    {
+        pdtQuatRot->q0 = 1.0f;
+        pdtQuatRot->qx =
+        pdtQuatRot->qy =
+        pdtQuatRot->qz = 0.0f;
+
+        return;
+    } /* if */
+
+    pdtQuatRot->q0 = float(pdtQuatRot->q0 / dLength);
+    pdtQuatRot->qx = float(pdtQuatRot->qx / dLength);
+    pdtQuatRot->qy = float(pdtQuatRot->qy / dLength);
+    pdtQuatRot->qz = float(pdtQuatRot->qz / dLength);
+} /* QuatNormalize */
+
+/*****************************************************************
+Name:            QuatSlerp
+
+Input Values:
+    QuatRotation
+       *pdtQuatRot1         : rotation at dT = 0
+       *pdtQuatRot2         : rotation at dT = 1
+    double
+        dT                  : fraction of the way from the first
+                              rotation to the second
+
+Output Values:
+    QuatRotation
+       *pdtQuatRotOut       : interpolated rotation
+
+Returned Value:
+    None
+
+Description:
+    This routine spherically interpolates between two rotations
+    at a constant angular rate, taking the shorter way round.
+    Values of dT outside 0 to 1 carry on along the same arc, which
+    extrapolates the rotation.  Rotations that are almost the same
+    are interpolated linearly to avoid dividing by a tiny sine.
+*****************************************************************/
+void QuatSlerp( QuatRotation *pdtQuatRot1,
+                QuatRotation *pdtQuatRot2,
+                double dT,
+                QuatRotation *pdtQuatRotOut )
+{
+    double
+        dCos,
+        dSign = 1.0,
+        dAngle,
+        dSin,
+        dScale1,
+        dScale2;
+
+    dCos = (double)pdtQuatRot1->q0 * pdtQuatRot2->q0
+         + (double)pdtQuatRot1->qx * pdtQuatRot2->qx
+         + (double)pdtQuatRot1->qy * pdtQuatRot2->qy
+         + (double)pdtQuatRot1->qz * pdtQuatRot2->qz;
+
+    /* q and -q are the same rotation, use the one nearer the first */
+    if( dCos < 0.0 )
+    {
+        dCos = -dCos;
+        dSign = -1.0;
+    } /* if */
+
+    if( dCos > 0.9995 )
+    {
+        dScale1 = 1.0 - dT;
+        dScale2 = dT;
+    }
+    else
+    {
+        dAngle = acos( dCos );
+        dSin = sin( dAngle );
+        dScale1 = sin( ( 1.0 - dT ) * dAngle ) / dSin;
+        dScale2 = sin( dT * dAngle ) / dSin;
+    } /* else */
+
+    dScale2 *= dSign;
+
+    pdtQuatRotOut->q0 = float(dScale1 * pdtQuatRot1->q0 + dScale2 * pdtQuatRot2->q0);
+    pdtQuatRotOut->qx = float(dScale1 * pdtQuatRot1->qx + dScale2 * pdtQuatRot2->qx);
+    pdtQuatRotOut->qy = float(dScale1 * pdtQuatRot1->qy + dScale2 * pdtQuatRot2->qy);
+    pdtQuatRotOut->qz = float(dScale1 * pdtQuatRot1->qz + dScale2 * pdtQuatRot2->qz);
+
+    QuatNormalize( pdtQuatRotOut );
+} /* QuatSlerp */
 /**************************END OF FILE***************************/
@@ -90,5 +90,11 @@ Routine Definitions
 						   QuatTransformation *pdtXfrm23,
 						   QuatTransformation *pdtXfrm13 );
 
+	void QuatNormalize( QuatRotation *pdtQuatRot );
+	void QuatSlerp( QuatRotation *pdtQuatRot1,
+					QuatRotation *pdtQuatRot2,
+					double dT,
+					QuatRotation *pdtQuatRotOut );
+
 /************************END OF FILE*****************************/
 
@@ -0,0 +1,469 @@
+#include "broadcastRing.h"
+#include <boost/thread.hpp>
+#include <boost/chrono.hpp>
+#include <cstring>
+
+broadcastRing::broadcastRing(size_t capacity) : capacity(capacity), stamps(new boost::atomic<boost::uint64_t>[capacity])
+{
+	writeCount = 0;
+
+	for( int i = 0; i != MAX_RING_SUBSCRIBERS; ++i )
+	{
+		subscribers[i].active = false;
+		subscribers[i].cursor = 0;
+		subscribers[i].policy = OVERFLOW_OVERWRITE_OLDEST;
+		subscribers[i].blockMs = 0;
+		subscribers[i].mailbox = NULL;
+		resetCounters(subscribers[i]);
+	}
+
+	writerWaiting = false;
+
+	configure(0);
+}
+
+broadcastRing::~broadcastRing()
+{
+	for( int i = 0; i != MAX_RING_SUBSCRIBERS; ++i )
+	{
+		delete subscribers[i].mailbox.load();
+	}
+}
+
+void broadcastRing::configure(int numSensors)
+{
+	this->numSensors = numSensors;
+
+	// Header then the records, rounded up to whole words
+	size_t slotBytes = sizeof(sensorFrameHeader) + numSensors * sizeof(sensorRecord);
+	slotWords = ( slotBytes + sizeof(boost::uint64_t) - 1 ) / sizeof(boost::uint64_t);
+
+	storage.assign(capacity * slotWords, 0);
+
+	for( size_t i = 0; i != capacity; ++i )
+	{
+		stamps[i] = 0;
+	}
+
+	// Start everyone from an empty ring
+	writeCount = 0;
+	for( int i = 0; i != MAX_RING_SUBSCRIBERS; ++i )
+	{
+		subscribers[i].cursor = 0;
+		if( subscribers[i].mailbox.load() != NULL ) subscribers[i].mailbox.load()->configure(numSensors);
+		resetCounters(subscribers[i]);
+	}
+}
+
+void broadcastRing::resetCounters(ringSubscriber &subscriber)
+{
+	subscriber.overruns = 0;
+	subscriber.pushed = 0;
+	subscriber.dropped = 0;
+	subscriber.highWaterMark = 0;
+}
+
+int broadcastRing::getNumSensors() const
+{
+	return numSensors;
+}
+
+size_t broadcastRing::getCapacity() const
+{
+	return capacity;
+}
+
+boost::uint64_t *broadcastRing::slotAt(boost::uint64_t index)
+{
+	return &storage[size_t( index % capacity ) * slotWords];
+}
+
+frameRing *broadcastRing::mailboxOf(int subscriber) const
+{
+	const ringSubscriber &reader = subscribers[subscriber];
+
+	if( reader.policy.load(boost::memory_order_acquire) == OVERFLOW_OVERWRITE_OLDEST ) return NULL;
+	return reader.mailbox.load(boost::memory_order_acquire);
+}
+
+bool broadcastRing::waitForRoom(const ringSubscriber &reader, frameRing &mailbox, const sensorFrameHeader &header, const sensorRecord *sensors,
+	const boost::chrono::steady_clock::time_point &deadline)
+{
+	boost::unique_lock<boost::mutex> guard(roomMutex);
+	bool pushed = false;
+
+	// Register before trying again so a read in between can't be missed
+	writerWaiting.store(true, boost::memory_order_seq_cst);
+	boost::atomic_thread_fence(boost::memory_order_seq_cst);
+
+	while( !( pushed = mailbox.push(header, sensors) ) )
+	{
+		// Give up on a subscriber that has gone or stopped blocking
+		if( !reader.active.load(boost::memory_order_acquire) || reader.policy.load(boost::memory_order_acquire) != OVERFLOW_BLOCK ) break;
+
+		if( roomCondition.wait_until(guard, deadline) == boost::cv_status::timeout )
+		{
+			pushed = mailbox.push(header, sensors);
+			break;
+		}
+	}
+
+	writerWaiting.store(false, boost::memory_order_relaxed);
+
+	return pushed;
+}
+
+void broadcastRing::wakeWriter()
+{
+	// Only wake the writer if it is asleep, the fence pairs with the writer registering
+	boost::atomic_thread_fence(boost::memory_order_seq_cst);
+
+	if( writerWaiting.load(boost::memory_order_seq_cst) )
+	{
+		boost::lock_guard<boost::mutex> guard(roomMutex);
+		roomCondition.notify_all();
+	}
+}
+
+bool broadcastRing::publish(const sensorFrameHeader &header, const sensorRecord *sensors)
+{
+	boost::uint64_t index = writeCount.load(boost::memory_order_relaxed);
+	boost::chrono::steady_clock::time_point start;
+	bool started = false;
+	bool delivered = true;
+
+	// Subscribers with a mailbox get their copy first, a full mailbox only costs that subscriber the frame
+	for( int i = 0; i != MAX_RING_SUBSCRIBERS; ++i )
+	{
+		ringSubscriber &reader = subscribers[i];
+
+		if( !reader.active.load(boost::memory_order_acquire) ) continue;
+
+		reader.pushed.fetch_add(1, boost::memory_order_relaxed);
+
+		frameRing *mailbox = mailboxOf(i);
+		size_t unread;
+
+		if( mailbox == NULL )
+		{
+			boost::uint64_t lag = index + 1 - reader.cursor.load(boost::memory_order_relaxed);
+			unread = size_t( lag > capacity ? capacity : lag );
+		}
+		else
+		{
+			bool pushed = mailbox->push(header, sensors);
+
+			if( !pushed && reader.policy.load(boost::memory_order_relaxed) == OVERFLOW_BLOCK )
+			{
+				// Blocking subscribers all count their wait from the same start
+				if( !started )
+				{
+					start = boost::chrono::steady_clock::now();
+					started = true;
+				}
+
+				pushed = waitForRoom(reader, *mailbox, header, sensors, start + boost::chrono::milliseconds(reader.blockMs.load(boost::memory_order_relaxed)));
+			}
+
+			if( !pushed )
+			{
+				reader.dropped.fetch_add(1, boost::memory_order_relaxed);
+				delivered = false;
+				continue;
+			}
+
+			unread = mailbox->read_available();
+		}
+
+		if( unread > reader.highWaterMark.load(boost::memory_order_relaxed) ) reader.highWaterMark.store(unread, boost::memory_order_relaxed);
+	}
+
+	boost::atomic<boost::uint64_t> &stamp = stamps[size_t( index % capacity )];
+
+	// Mark the slot as being written before touching it
+	stamp.store(0, boost::memory_order_relaxed);
+	boost::atomic_thread_fence(boost::memory_order_release);
+
+	sensorFrameHeader *slotHeader = reinterpret_cast<sensorFrameHeader *>(slotAt(index));
+	*slotHeader = header;
+	slotHeader->numSensors = numSensors;
+	if( numSensors > 0 ) std::memcpy(slotHeader + 1, sensors, numSensors * sizeof(sensorRecord));
+
+	// Publish the slot, then the frame
+	stamp.store(index + 1, boost::memory_order_release);
+	writeCount.store(index + 1, boost::memory_order_release);
+
+	return delivered;
+}
+
+boost::uint64_t broadcastRing::getPublished() const
+{
+	return writeCount.load(boost::memory_order_acquire);
+}
+
+int broadcastRing::subscribe()
+{
+	for( int i = 0; i != MAX_RING_SUBSCRIBERS; ++i )
+	{
+		bool inactive = false;
+
+		// Claim the first free entry
+		if( subscribers[i].active.compare_exchange_strong(inactive, true) )
+		{
+			// The policy was put back to overwrite-oldest on unsubscribe, so the writer ignores the cursor until it is set
+			resetCounters(subscribers[i]);
+			subscribers[i].cursor.store(writeCount.load(boost::memory_order_acquire), boost::memory_order_release);
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+void broadcastRing::unsubscribe(int subscriber)
+{
+	if( subscriber < 0 || subscriber >= MAX_RING_SUBSCRIBERS ) return;
+
+	// Stop holding the writer back before letting go of the entry
+	subscribers[subscriber].policy.store(OVERFLOW_OVERWRITE_OLDEST, boost::memory_order_release);
+	subscribers[subscriber].blockMs.store(0, boost::memory_order_relaxed);
+	subscribers[subscriber].active.store(false, boost::memory_order_release);
+	wakeWriter();
+}
+
+void broadcastRing::setOverflowPolicy(int subscriber, overflowPolicy policy, unsigned int msBlock)
+{
+	if( subscriber < 0 || subscriber >= MAX_RING_SUBSCRIBERS ) return;
+
+	ringSubscriber &reader = subscribers[subscriber];
+	bool hadMailbox = ( mailboxOf(subscriber) != NULL );
+	bool wantsMailbox = ( policy != OVERFLOW_OVERWRITE_OLDEST );
+	frameRing *mailbox = reader.mailbox.load(boost::memory_order_acquire);
+
+	// Made once and kept, the writer may still be copying into it just after the policy changes back
+	if( wantsMailbox && mailbox == NULL )
+	{
+		mailbox = new frameRing(capacity);
+		mailbox->configure(numSensors);
+		reader.mailbox.store(mailbox, boost::memory_order_release);
+	}
+
+	// Leave behind what is unread in the ring, and anything left from an earlier spell in the mailbox
+	if( wantsMailbox && !hadMailbox )
+	{
+		trimLag(subscriber, 0);
+		mailbox->trimLag(0);
+	}
+
+	reader.blockMs.store(msBlock, boost::memory_order_relaxed);
+	reader.policy.store(policy, boost::memory_order_release);
+
+	// Back to reading the ring from the next frame, what the mailbox still holds is lost
+	if( hadMailbox && !wantsMailbox )
+	{
+		reader.overruns.fetch_add((unsigned long)mailbox->trimLag(0), boost::memory_order_relaxed);
+		reader.cursor.store(writeCount.load(boost::memory_order_acquire), boost::memory_order_release);
+	}
+
+	// A writer blocked on the old policy rechecks it
+	wakeWriter();
+}
+
+void broadcastRing::getStatistics(int subscriber, queueStatistics &statistics) const
+{
+	const ringSubscriber &reader = subscribers[subscriber];
+
+	statistics.pushed = reader.pushed.load(boost::memory_order_relaxed);
+	statistics.dropped = reader.dropped.load(boost::memory_order_relaxed) + reader.overruns.load(boost::memory_order_relaxed);
+	statistics.highWaterMark = reader.highWaterMark.load(boost::memory_order_relaxed);
+	statistics.capacity = capacity;
+}
+
+bool broadcastRing::peek(int subscriber, sensorFrameView &view)
+{
+	ringSubscriber &reader = subscribers[subscriber];
+	frameRing *mailbox = mailboxOf(subscriber);
+
+	if( mailbox != NULL ) return mailbox->peek(view);
+
+	for(;;)
+	{
+		boost::uint64_t cursor = reader.cursor.load(boost::memory_order_relaxed);
+		boost::uint64_t written = writeCount.load(boost::memory_order_acquire);
+
+		// Nothing new
+		if( cursor == written ) return false;
+
+		// Lapped by the writer, skip to the oldest frame still in the ring
+		if( written - cursor > capacity )
+		{
+			reader.overruns.fetch_add((unsigned long)( written - cursor - capacity ), boost::memory_order_relaxed);
+			cursor = written - capacity;
+			reader.cursor.store(cursor, boost::memory_order_release);
+		}
+
+		// The writer may already be overwriting the oldest slot, if so it is lost too
+		if( stamps[size_t( cursor % capacity )].load(boost::memory_order_acquire) != cursor + 1 )
+		{
+			reader.overruns.fetch_add(1, boost::memory_order_relaxed);
+			reader.cursor.store(cursor + 1, boost::memory_order_release);
+			continue;
+		}
+
+		const sensorFrameHeader *slotHeader = reinterpret_cast<const sensorFrameHeader *>(slotAt(cursor));
+		view.header = slotHeader;
+		view.sensors = reinterpret_cast<const sensorRecord *>(slotHeader + 1);
+		return true;
+	}
+}
+
+bool broadcastRing::release(int subscriber)
+{
+	ringSubscriber &reader = subscribers[subscriber];
+	frameRing *mailbox = mailboxOf(subscriber);
+
+	// Nothing writes a mailbox slot until it is handed back
+	if( mailbox != NULL )
+	{
+		mailbox->release();
+		wakeWriter();
+		return true;
+	}
+
+	// Make sure everything read from the slot happened before the stamp is checked again
+	boost::atomic_thread_fence(boost::memory_order_acquire);
+
+	boost::uint64_t cursor = reader.cursor.load(boost::memory_order_relaxed);
+	bool intact = ( stamps[size_t( cursor % capacity )].load(boost::memory_order_relaxed) == cursor + 1 );
+
+	if( !intact ) reader.overruns.fetch_add(1, boost::memory_order_relaxed);
+
+	reader.cursor.store(cursor + 1, boost::memory_order_release);
+	return intact;
+}
+
+bool broadcastRing::pop(int subscriber, sensorFrame &frame)
+{
+	sensorFrameView view;
+
+	frame.resize(numSensors);
+
+	// Keep going until a frame is read without the writer getting to it first
+	while( peek(subscriber, view) )
+	{
+		frame.header = *view.header;
+		if( numSensors > 0 ) std::memcpy(&frame.sensors[0], view.sensors, numSensors * sizeof(sensorRecord));
+
+		if( release(subscriber) ) return true;
+	}
+
+	return false;
+}
+
+size_t broadcastRing::popBulk(int subscriber, sensorFrameHeader *headers, sensorRecord *sensors, size_t maxFrames)
+{
+	ringSubscriber &reader = subscribers[subscriber];
+	frameRing *mailbox = mailboxOf(subscriber);
+	size_t recordBytes = numSensors * sizeof(sensorRecord);
+
+	if( mailbox != NULL )
+	{
+		sensorFrameView view;
+		size_t copied = 0;
+
+		while( copied != maxFrames && mailbox->peek(view) )
+		{
+			headers[copied] = *view.header;
+			if( recordBytes > 0 ) std::memcpy(sensors + copied * numSensors, view.sensors, recordBytes);
+			mailbox->release();
+			++copied;
+		}
+
+		if( copied > 0 ) wakeWriter();
+		return copied;
+	}
+
+	// Skip anything the writer has lapped, then take what is there in one go
+	trimLag(subscriber, capacity);
+
+	boost::uint64_t cursor = reader.cursor.load(boost::memory_order_relaxed);
+	boost::uint64_t written = writeCount.load(boost::memory_order_acquire);
+	size_t count = size_t( written - cursor );
+	if( count > maxFrames ) count = maxFrames;
+	if( count == 0 ) return 0;
+
+	for( size_t i = 0; i != count; ++i )
+	{
+		const sensorFrameHeader *slotHeader = reinterpret_cast<const sensorFrameHeader *>(slotAt(cursor + i));
+		headers[i] = *slotHeader;
+		if( recordBytes > 0 ) std::memcpy(sensors + i * numSensors, slotHeader + 1, recordBytes);
+	}
+
+	// One check after the whole copy. The writer overwrites oldest first, so any damaged frames are at the front
+	boost::atomic_thread_fence(boost::memory_order_acquire);
+
+	size_t damaged = 0;
+	while( damaged != count && stamps[size_t( ( cursor + damaged ) % capacity )].load(boost::memory_order_relaxed) != cursor + damaged + 1 )
+	{
+		++damaged;
+	}
+
+	if( damaged > 0 )
+	{
+		reader.overruns.fetch_add((unsigned long)damaged, boost::memory_order_relaxed);
+		std::memmove(headers, headers + damaged, ( count - damaged ) * sizeof(sensorFrameHeader));
+		if( recordBytes > 0 ) std::memmove(sensors, sensors + damaged * numSensors, ( count - damaged ) * recordBytes);
+	}
+
+	reader.cursor.store(cursor + count, boost::memory_order_release);
+
+	return count - damaged;
+}
+
+void broadcastRing::trimLag(int subscriber, size_t maxLag)
+{
+	ringSubscriber &reader = subscribers[subscriber];
+	frameRing *mailbox = mailboxOf(subscriber);
+
+	if( mailbox != NULL )
+	{
+		size_t skipped = mailbox->trimLag(maxLag);
+		reader.overruns.fetch_add((unsigned long)skipped, boost::memory_order_relaxed);
+		if( skipped > 0 ) wakeWriter();
+		return;
+	}
+
+	boost::uint64_t cursor = reader.cursor.load(boost::memory_order_relaxed);
+	boost::uint64_t written = writeCount.load(boost::memory_order_acquire);
+
+	if( written - cursor <= maxLag ) return;
+
+	reader.overruns.fetch_add((unsigned long)( written - cursor - maxLag ), boost::memory_order_relaxed);
+	reader.cursor.store(written - maxLag, boost::memory_order_release);
+}
+
+size_t broadcastRing::getLag(int subscriber) const
+{
+	frameRing *mailbox = mailboxOf(subscriber);
+
+	if( mailbox != NULL ) return mailbox->read_available();
+
+	boost::uint64_t lag = writeCount.load(boost::memory_order_acquire) - subscribers[subscriber].cursor.load(boost::memory_order_acquire);
+
+	return size_t( lag > capacity ? capacity : lag );
+}
+
+unsigned long broadcastRing::getOverruns(int subscriber) const
+{
+	return subscribers[subscriber].overruns.load(boost::memory_order_relaxed);
+}
+
+void broadcastRing::prefault()
+{
+	if( !storage.empty() ) std::memset(&storage[0], 0, storage.size() * sizeof(boost::uint64_t));
+
+	for( int i = 0; i != MAX_RING_SUBSCRIBERS; ++i )
+	{
+		if( subscribers[i].mailbox.load() != NULL ) subscribers[i].mailbox.load()->prefault();
+	}
+}
@@ -0,0 +1,135 @@
+/*
+	Single writer, multiple reader ring of frames in the style of a
+	disruptor.  Each frame is written once and every subscriber reads
+	it through its own cursor, so adding a consumer costs neither
+	another queue nor another copy.  The writer never waits for the
+	readers: a subscriber that falls more than a ring behind loses the
+	oldest frames, and that is counted as an overrun.  Every slot
+	carries a stamp so a reader can tell if the slot was overwritten
+	while it was looking at it.
+
+	Each subscriber picks what happens when it is a whole ring
+	behind.  Overwrite-oldest leaves the writer alone and the
+	subscriber loses its oldest frames.  Drop-newest and block give
+	the subscriber a mailbox of its own that the writer copies each
+	frame into, so when it is full only that subscriber misses the
+	frame.  Block first waits a bounded time for the subscriber to
+	read a frame, holding up the writer, which is woken as soon as
+	there is room.
+*/
+
+#include "sensorFrame.h"
+#include "frameRing.h"
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/chrono.hpp>
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/scoped_array.hpp>
+#include <vector>
+
+#pragma once
+
+// Most subscribers a ring can have at once
+const int MAX_RING_SUBSCRIBERS = 16;
+
+// What the writer does when a subscriber is a whole ring behind
+enum overflowPolicy
+{
+	OVERFLOW_OVERWRITE_OLDEST,	// Carry on, the subscriber loses its oldest unread frame
+	OVERFLOW_DROP_NEWEST,		// The subscriber misses the new frame
+	OVERFLOW_BLOCK				// Wait up to the subscriber's block time for room, then it misses the new frame
+};
+
+// Queue counters of one subscriber
+typedef struct queueStatisticsStruct
+{
+	unsigned long pushed;		// Frames offered while subscribed
+	unsigned long dropped;		// Frames the subscriber never got, held back or overwritten
+	size_t highWaterMark;		// Most unread frames seen by the writer
+	size_t capacity;
+} queueStatistics;
+
+// State of one subscriber
+typedef struct ringSubscriberStruct
+{
+	boost::atomic<bool> active;
+	boost::atomic<boost::uint64_t> cursor;		// Next frame to read, only the subscriber moves it
+	boost::atomic<unsigned long> overruns;		// Frames lost because the writer lapped the subscriber
+	boost::atomic<int> policy;					// overflowPolicy
+	boost::atomic<unsigned int> blockMs;
+	boost::atomic<frameRing *> mailbox;			// Own copy of the frames under drop-newest and block, kept once made
+	boost::atomic<unsigned long> pushed;		// Counters kept by the writer
+	boost::atomic<unsigned long> dropped;		// Frames missed with a full mailbox, lapped frames are in overruns
+	boost::atomic<size_t> highWaterMark;
+} ringSubscriber;
+
+class broadcastRing
+{
+
+public:
+	explicit broadcastRing(size_t capacity);
+	~broadcastRing();
+
+	// Size the slots for numSensors and empty the ring. Only call while nothing is publishing or reading
+	void configure(int numSensors);
+	int getNumSensors() const;
+	size_t getCapacity() const;
+
+	// Writer side, single thread only. The frame always goes in the ring, returns false if a full mailbox missed it
+	bool publish(const sensorFrameHeader &header, const sensorRecord *sensors);
+	boost::uint64_t getPublished() const;
+
+	// Subscribers start at the next frame published, returns -1 if there are none free
+	int subscribe();
+	void unsubscribe(int subscriber);
+
+	// New subscribers overwrite their oldest frames, msBlock is only used by OVERFLOW_BLOCK. Call from the thread
+	// that reads the subscriber, or while it isn't reading. Frames not yet read are dropped if the mailbox comes or goes
+	void setOverflowPolicy(int subscriber, overflowPolicy policy, unsigned int msBlock);
+	void getStatistics(int subscriber, queueStatistics &statistics) const;
+
+	// Zero copy read of the next frame, the view points into the ring.
+	// release() moves past it and returns false if the writer overwrote the slot while it was being read
+	bool peek(int subscriber, sensorFrameView &view);
+	bool release(int subscriber);
+
+	// Copying read of the next frame that was read intact
+	bool pop(int subscriber, sensorFrame &frame);
+
+	// Copy up to maxFrames unread frames in one pass, sensors holds maxFrames * getNumSensors() records.
+	// Returns the number copied, frames overwritten during the copy are left out and count as overruns
+	size_t popBulk(int subscriber, sensorFrameHeader *headers, sensorRecord *sensors, size_t maxFrames);
+
+	// Skip the oldest unread frames so at most maxLag are left, skipped frames count as overruns
+	void trimLag(int subscriber, size_t maxLag);
+
+	// Frames published but not yet read, and frames lost to the writer
+	size_t getLag(int subscriber) const;
+	unsigned long getOverruns(int subscriber) const;
+
+	// Write to every slot so the pages are resident before time critical use. Only call while stopped
+	void prefault();
+
+private:
+	boost::uint64_t *slotAt(boost::uint64_t index);
+	frameRing *mailboxOf(int subscriber) const;
+	bool waitForRoom(const ringSubscriber &reader, frameRing &mailbox, const sensorFrameHeader &header, const sensorRecord *sensors,
+		const boost::chrono::steady_clock::time_point &deadline);
+	void wakeWriter();
+	void resetCounters(ringSubscriber &subscriber);
+
+	size_t capacity;
+	int numSensors;
+	size_t slotWords;								// Slot size in 8 byte words, keeps every header aligned
+	std::vector<boost::uint64_t> storage;
+	boost::scoped_array< boost::atomic<boost::uint64_t> > stamps;	// Index + 1 of the frame in each slot, 0 while it is written
+
+	boost::atomic<boost::uint64_t> writeCount;		// Frames ever published
+	ringSubscriber subscribers[MAX_RING_SUBSCRIBERS];
+
+	// A blocked writer registers so readers only take the mutex when it is asleep
+	boost::atomic<bool> writerWaiting;
+	boost::mutex roomMutex;
+	boost::condition_variable roomCondition;
+};
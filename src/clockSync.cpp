@@ -0,0 +1,267 @@
+#include "clockSync.h"
+#include <algorithm>
+
+clockSync::clockSync() : sampleFrames(CLOCK_SYNC_WINDOW), sampleTimes(CLOCK_SYNC_WINDOW), earliestSamples(CLOCK_SYNC_WINDOW)
+{
+	currentState.restarts = 0;
+	byteMs = 0.0;
+	reset();
+}
+
+void clockSync::reset()
+{
+	haveSample = false;
+	baseFrame = 0;
+	lastFrameNumber = 0;
+	samplesAdded = 0;
+	numSamples = 0;
+	outliersInRow = 0;
+	intercept = 0.0;
+	slope = 0.0;
+	meanFrames = 0.0;
+	meanTime = 0.0;
+	sumFramesFrames = 0.0;
+	sumFramesTime = 0.0;
+	earliestFirst = 0;
+	earliestCount = 0;
+	referenceSlope = 0.0;
+
+	stateLock.writeBegin();
+	currentState.locked = false;
+	currentState.framePeriodMs = 0.0;
+	currentState.offsetMs = 0.0;
+	currentState.jitterMs = 0.0;
+	currentState.samples = 0;
+	currentState.outliers = 0;
+	currentState.restarts = 0;
+	stateLock.writeEnd();
+}
+
+void clockSync::setLinkRate(unsigned long bitsPerSecond)
+{
+	byteMs = bitsPerSecond > 0 ? 1000.0 * CLOCK_SYNC_BITS_PER_BYTE / bitsPerSecond : 0.0;
+}
+
+void clockSync::restart(unsigned long frameNumber, schedulerTime receiveTime)
+{
+	baseFrame = frameNumber;
+	baseTime = receiveTime;
+	samplesAdded = 0;
+	numSamples = 0;
+	outliersInRow = 0;
+	meanFrames = 0.0;
+	meanTime = 0.0;
+	sumFramesFrames = 0.0;
+	sumFramesTime = 0.0;
+	earliestFirst = 0;
+	earliestCount = 0;
+
+	stateLock.writeBegin();
+	currentState.locked = false;
+	if( haveSample ) ++currentState.restarts;
+	stateLock.writeEnd();
+
+	haveSample = true;
+}
+
+double clockSync::lineAt(double frames) const
+{
+	return intercept + slope * frames;
+}
+
+schedulerTime clockSync::timeAt(double frames) const
+{
+	// The fitted line moved down to the earliest replies
+	return baseTime + boost::chrono::duration_cast<schedulerTime::duration>(
+		boost::chrono::duration<double, boost::milli>(lineAt(frames) + currentState.offsetMs));
+}
+
+schedulerTime clockSync::addSample(unsigned long frameNumber, schedulerTime receiveTime, size_t replyBytes)
+{
+	// The frame was ready when the reply started down the line, not when its last byte arrived
+	receiveTime -= boost::chrono::duration_cast<schedulerTime::duration>(boost::chrono::duration<double, boost::milli>(byteMs * replyBytes));
+
+	// The device started counting again, or this is the first frame
+	if( !haveSample || frameNumber <= lastFrameNumber ) restart(frameNumber, receiveTime);
+	lastFrameNumber = frameNumber;
+
+	double frames = double( frameNumber - baseFrame );
+	double time = boost::chrono::duration<double, boost::milli>(receiveTime - baseTime).count();
+	bool locked = ( numSamples >= (size_t)CLOCK_SYNC_MIN_SAMPLES );
+
+	// Reject replies held up far longer than usual, they would drag the line late
+	if( locked )
+	{
+		double delay = time - lineAt(frames) - currentState.offsetMs;
+		double limit = CLOCK_SYNC_OUTLIER_LIMIT * std::max(currentState.jitterMs, CLOCK_SYNC_MIN_JITTER_MS);
+
+		if( delay > limit )
+		{
+			stateLock.writeBegin();
+			++currentState.outliers;
+			stateLock.writeEnd();
+
+			// Too many in a row means the fit, not the replies, is wrong
+			if( ++outliersInRow < CLOCK_SYNC_MAX_OUTLIERS ) return timeAt(frames);
+
+			restart(frameNumber, receiveTime);
+			frames = 0.0;
+			time = 0.0;
+		}
+	}
+	outliersInRow = 0;
+
+	// Replace the oldest sample
+	size_t slot = size_t( samplesAdded % CLOCK_SYNC_WINDOW );
+
+	if( numSamples == (size_t)CLOCK_SYNC_WINDOW ) removeFromFit(sampleFrames[slot], sampleTimes[slot], numSamples--);
+
+	sampleFrames[slot] = frames;
+	sampleTimes[slot] = time;
+	++samplesAdded;
+	++numSamples;
+
+	// Start the sums afresh each time the sample count doubles and as the window comes round, so rounding can't build up
+	if( ( samplesAdded & ( samplesAdded - 1 ) ) == 0 || samplesAdded % CLOCK_SYNC_WINDOW == 0 )
+	{
+		refit();
+	}
+	else
+	{
+		addToFit(frames, time, numSamples);
+		pushEarliest(samplesAdded - 1);
+	}
+
+	fit();
+
+	if( numSamples < (size_t)CLOCK_SYNC_MIN_SAMPLES ) return receiveTime;
+
+	return timeAt(frames);
+}
+
+void clockSync::addToFit(double frames, double time, size_t count)
+{
+	// Welford's update, count includes the new sample
+	double dFrames = frames - meanFrames;
+
+	meanFrames += dFrames / count;
+	meanTime += ( time - meanTime ) / count;
+	sumFramesFrames += dFrames * ( frames - meanFrames );
+	sumFramesTime += dFrames * ( time - meanTime );
+}
+
+void clockSync::removeFromFit(double frames, double time, size_t count)
+{
+	// The update run backwards, count includes the sample going
+	if( count <= 1 )
+	{
+		meanFrames = 0.0;
+		meanTime = 0.0;
+		sumFramesFrames = 0.0;
+		sumFramesTime = 0.0;
+		return;
+	}
+
+	double dFrames = frames - meanFrames;
+	double dTime = time - meanTime;
+
+	meanFrames -= dFrames / ( count - 1 );
+	meanTime -= dTime / ( count - 1 );
+	sumFramesFrames -= ( frames - meanFrames ) * dFrames;
+	sumFramesTime -= ( frames - meanFrames ) * dTime;
+}
+
+void clockSync::refit()
+{
+	unsigned long first = samplesAdded - numSamples;
+
+	meanFrames = 0.0;
+	meanTime = 0.0;
+
+	for( size_t i = 0; i != numSamples; ++i )
+	{
+		meanFrames += sampleFrames[i];
+		meanTime += sampleTimes[i];
+	}
+	meanFrames /= numSamples;
+	meanTime /= numSamples;
+
+	// Least squares about the means, keeps the sums small however long the session
+	sumFramesFrames = 0.0;
+	sumFramesTime = 0.0;
+
+	for( size_t i = 0; i != numSamples; ++i )
+	{
+		double dFrames = sampleFrames[i] - meanFrames;
+		sumFramesFrames += dFrames * dFrames;
+		sumFramesTime += dFrames * ( sampleTimes[i] - meanTime );
+	}
+
+	// Measure the replies against the new slope from now on
+	referenceSlope = sumFramesFrames > 0.0 ? sumFramesTime / sumFramesFrames : 0.0;
+	earliestFirst = 0;
+	earliestCount = 0;
+
+	for( unsigned long sample = first; sample != samplesAdded; ++sample )
+	{
+		pushEarliest(sample);
+	}
+}
+
+double clockSync::referenceTime(unsigned long sample) const
+{
+	size_t slot = size_t( sample % CLOCK_SYNC_WINDOW );
+
+	return sampleTimes[slot] - referenceSlope * sampleFrames[slot];
+}
+
+void clockSync::pushEarliest(unsigned long sample)
+{
+	// Drop the front once its slot has been reused
+	if( earliestCount > 0 && earliestSamples[earliestFirst] + CLOCK_SYNC_WINDOW <= sample )
+	{
+		earliestFirst = ( earliestFirst + 1 ) % CLOCK_SYNC_WINDOW;
+		--earliestCount;
+	}
+
+	// Anything no earlier than the new reply can never be the earliest again
+	double time = referenceTime(sample);
+
+	while( earliestCount > 0 && referenceTime(earliestSamples[( earliestFirst + earliestCount - 1 ) % CLOCK_SYNC_WINDOW]) >= time )
+	{
+		--earliestCount;
+	}
+
+	earliestSamples[( earliestFirst + earliestCount ) % CLOCK_SYNC_WINDOW] = sample;
+	++earliestCount;
+}
+
+void clockSync::fit()
+{
+	slope = sumFramesFrames > 0.0 ? sumFramesTime / sumFramesFrames : 0.0;
+	intercept = meanTime - slope * meanFrames;
+
+	// Move the line down to the earliest reply. The residuals average zero, so the others are -earliest late on average
+	size_t slot = size_t( earliestSamples[earliestFirst] % CLOCK_SYNC_WINDOW );
+	double earliest = sampleTimes[slot] - lineAt(sampleFrames[slot]);
+
+	stateLock.writeBegin();
+	currentState.locked = ( numSamples >= (size_t)CLOCK_SYNC_MIN_SAMPLES );
+	currentState.framePeriodMs = slope;
+	currentState.offsetMs = earliest;
+	currentState.jitterMs = -earliest;
+	currentState.samples = (unsigned long)numSamples;
+	stateLock.writeEnd();
+}
+
+void clockSync::getState(clockSyncState &state) const
+{
+	boost::uint64_t begin;
+
+	do
+	{
+		begin = stateLock.readBegin();
+		state = currentState;
+	}
+	while( stateLock.readRetry(begin) );
+}
@@ -0,0 +1,100 @@
+/*
+	Maps device frame numbers onto the host's steady clock.  A line
+	is fitted to the frame numbers and receive times of the last few
+	thousand frames, so its slope follows the drift between the two
+	clocks, and it is then moved down to the earliest replies as
+	serial delays only ever make a reply late.  Each reply is timed
+	from its first byte, by taking off the time the reply takes to
+	come down the line at the baud rate.  The fit is kept as running
+	sums, so a sample costs the same however big the window.  Replies much later
+	than the fit are rejected as outliers, and a frame number going
+	backwards or a run of outliers starts the fit again.
+*/
+
+#include "frameScheduler.h"
+#include "seqLock.h"
+#include <boost/chrono.hpp>
+#include <vector>
+
+#pragma once
+
+// Clock sync constants
+const int CLOCK_SYNC_WINDOW = 2048;				// Samples in the fit, about 50 s at 40 Hz
+const int CLOCK_SYNC_MIN_SAMPLES = 8;			// Before the fit is used, receive times are used until then
+const double CLOCK_SYNC_OUTLIER_LIMIT = 5.0;	// Replies later than this many times the jitter are rejected
+const double CLOCK_SYNC_MIN_JITTER_MS = 0.25;	// Floor of the jitter used for rejection
+const int CLOCK_SYNC_MAX_OUTLIERS = 16;			// Outliers in a row before the fit is started again
+const int CLOCK_SYNC_BITS_PER_BYTE = 10;		// Start, eight data and stop bits on the line
+
+// State of the fit
+typedef struct clockSyncStateStruct
+{
+	bool locked;
+	double framePeriodMs;		// Host time per device frame, follows the drift between the clocks
+	double offsetMs;			// Shortest delay from the fitted line to a reply, taken off every estimate
+	double jitterMs;			// Mean delay of the replies beyond the shortest
+	unsigned long samples;
+	unsigned long outliers;
+	unsigned long restarts;
+} clockSyncState;
+
+class clockSync
+{
+
+public:
+	clockSync();
+
+	// Forget the fit, call before tracking starts
+	void reset();
+
+	// Baud rate of the link, 0 takes replies as arriving all at once. Call before tracking starts
+	void setLinkRate(unsigned long bitsPerSecond);
+
+	// Tracking thread only. Adds the replyBytes long reply of a new frame, whose last byte came at receiveTime,
+	// and returns the estimated time the frame was measured
+	schedulerTime addSample(unsigned long frameNumber, schedulerTime receiveTime, size_t replyBytes);
+
+	// Any thread
+	void getState(clockSyncState &state) const;
+
+private:
+	void restart(unsigned long frameNumber, schedulerTime receiveTime);
+	void addToFit(double frames, double time, size_t count);
+	void removeFromFit(double frames, double time, size_t count);
+	void refit();
+	double referenceTime(unsigned long sample) const;
+	void pushEarliest(unsigned long sample);
+	void fit();
+	double lineAt(double frames) const;
+	schedulerTime timeAt(double frames) const;
+
+	unsigned long baseFrame;			// Samples are kept relative to the first one
+	schedulerTime baseTime;
+	unsigned long lastFrameNumber;
+	bool haveSample;
+
+	std::vector<double> sampleFrames;	// Frames since baseFrame
+	std::vector<double> sampleTimes;	// Milliseconds since baseTime
+	unsigned long samplesAdded;			// Since the restart, sample n is kept at n % CLOCK_SYNC_WINDOW
+	size_t numSamples;
+	int outliersInRow;
+	double byteMs;						// Time a reply byte takes on the line
+
+	// Least squares sums about the means, updated as samples come and go
+	double meanFrames;
+	double meanTime;
+	double sumFramesFrames;
+	double sumFramesTime;
+
+	// Sliding minimum of the replies measured against referenceSlope, the first is the earliest and the rest follow in order
+	std::vector<unsigned long> earliestSamples;
+	size_t earliestFirst;
+	size_t earliestCount;
+	double referenceSlope;
+
+	double intercept;					// Fitted time at baseFrame, milliseconds
+	double slope;						// Milliseconds per frame
+
+	clockSyncState currentState;
+	seqLock stateLock;
+};
@@ -0,0 +1,168 @@
+#include "frameDecimator.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Values summed for each sensor
+static const int SUMS_PER_SENSOR = 8;
+
+frameDecimator::frameDecimator(const frameDecimation &decimation) : decimation(decimation)
+{
+	configure(0);
+}
+
+void frameDecimator::configure(int numSensors)
+{
+	this->numSensors = numSensors;
+
+	lastSensors.assign(numSensors, sensorRecord());
+	sums.assign(numSensors * SUMS_PER_SENSOR, 0.0);
+	counts.assign(numSensors, 0);
+	statuses.assign(numSensors, 0);
+	minimum.assign(numSensors, sensorRecord());
+	maximum.assign(numSensors, sensorRecord());
+	outputs[0].resize(numSensors);
+	outputs[1].resize(numSensors);
+
+	lastTime = 0;
+	frameInterval = 0;
+	clearWindow();
+}
+
+void frameDecimator::clearWindow()
+{
+	framesInWindow = 0;
+	std::fill(sums.begin(), sums.end(), 0.0);
+	std::fill(counts.begin(), counts.end(), 0);
+	std::fill(statuses.begin(), statuses.end(), 0);
+}
+
+bool frameDecimator::windowComplete(boost::int64_t acquisitionTime)
+{
+	if( decimation.factor > 0 ) return framesInWindow >= decimation.factor;
+	if( decimation.rateHz <= 0.0 ) return true;
+
+	// Close on the frame nearest the period rather than the first one past it
+	boost::int64_t period = boost::int64_t( 1.0e9 / decimation.rateHz );
+	return acquisitionTime - windowStart + frameInterval >= period;
+}
+
+int frameDecimator::addFrame(const sensorFrameView &view)
+{
+	const sensorFrameHeader &header = *view.header;
+
+	if( framesInWindow == 0 ) windowStart = header.acquisitionTime;
+	if( lastTime != 0 ) frameInterval = header.acquisitionTime - lastTime;
+	lastTime = header.acquisitionTime;
+
+	lastHeader = header;
+	if( numSensors > 0 ) std::memcpy(&lastSensors[0], view.sensors, numSensors * sizeof(sensorRecord));
+
+	// Latest needs nothing gathered
+	if( decimation.aggregation != AGGREGATE_LATEST )
+	{
+		for( int i = 0; i != numSensors; ++i )
+		{
+			const sensorRecord &sensor = view.sensors[i];
+
+			if( ( sensor.status & SENSOR_NO_POSE_BITS ) || sensor.translation.x < MAX_NEGATIVE ) continue;
+
+			double *sum = &sums[i * SUMS_PER_SENSOR];
+
+			if( counts[i] == 0 )
+			{
+				minimum[i] = sensor;
+				maximum[i] = sensor;
+			}
+
+			// Keep the orientations in the same hemisphere as the first so they average
+			double sign = 1.0;
+			if( counts[i] > 0 && sensor.rotation.q0 * sum[3] + sensor.rotation.qx * sum[4] + sensor.rotation.qy * sum[5] + sensor.rotation.qz * sum[6] < 0.0 ) sign = -1.0;
+
+			sum[0] += sensor.translation.x;
+			sum[1] += sensor.translation.y;
+			sum[2] += sensor.translation.z;
+			sum[3] += sign * sensor.rotation.q0;
+			sum[4] += sign * sensor.rotation.qx;
+			sum[5] += sign * sensor.rotation.qy;
+			sum[6] += sign * sensor.rotation.qz;
+			sum[7] += sensor.error;
+
+			minimum[i].translation.x = std::min(minimum[i].translation.x, sensor.translation.x);
+			minimum[i].translation.y = std::min(minimum[i].translation.y, sensor.translation.y);
+			minimum[i].translation.z = std::min(minimum[i].translation.z, sensor.translation.z);
+			minimum[i].error = std::min(minimum[i].error, sensor.error);
+			maximum[i].translation.x = std::max(maximum[i].translation.x, sensor.translation.x);
+			maximum[i].translation.y = std::max(maximum[i].translation.y, sensor.translation.y);
+			maximum[i].translation.z = std::max(maximum[i].translation.z, sensor.translation.z);
+			maximum[i].error = std::max(maximum[i].error, sensor.error);
+
+			statuses[i] |= sensor.status;
+			++counts[i];
+		}
+	}
+
+	++framesInWindow;
+
+	if( !windowComplete(header.acquisitionTime) ) return 0;
+
+	int produced = aggregate();
+	clearWindow();
+	return produced;
+}
+
+int frameDecimator::aggregate()
+{
+	// Every output carries the last frame's header, and its record for sensors with no pose in the window
+	for( int n = 0; n != 2; ++n )
+	{
+		outputs[n].header = lastHeader;
+		if( numSensors > 0 ) std::memcpy(&outputs[n].sensors[0], &lastSensors[0], numSensors * sizeof(sensorRecord));
+	}
+
+	if( decimation.aggregation == AGGREGATE_LATEST ) return 1;
+
+	for( int i = 0; i != numSensors; ++i )
+	{
+		if( counts[i] == 0 ) continue;
+
+		sensorRecord &low = outputs[0].sensors[i];
+		sensorRecord &high = outputs[1].sensors[i];
+
+		if( decimation.aggregation == AGGREGATE_AVERAGE )
+		{
+			const double *sum = &sums[i * SUMS_PER_SENSOR];
+			double length = std::sqrt(sum[3] * sum[3] + sum[4] * sum[4] + sum[5] * sum[5] + sum[6] * sum[6]);
+
+			low.translation.x = float(sum[0] / counts[i]);
+			low.translation.y = float(sum[1] / counts[i]);
+			low.translation.z = float(sum[2] / counts[i]);
+			if( length > 0.0 )
+			{
+				low.rotation.q0 = float(sum[3] / length);
+				low.rotation.qx = float(sum[4] / length);
+				low.rotation.qy = float(sum[5] / length);
+				low.rotation.qz = float(sum[6] / length);
+			}
+			low.error = float(sum[7] / counts[i]);
+			low.status = statuses[i];
+		}
+		else
+		{
+			// Orientation stays the latest one, only positions and errors have an order
+			low.translation = minimum[i].translation;
+			low.error = minimum[i].error;
+			low.status = statuses[i];
+			high.translation = maximum[i].translation;
+			high.error = maximum[i].error;
+			high.status = statuses[i];
+		}
+	}
+
+	return decimation.aggregation == AGGREGATE_MINMAX ? 2 : 1;
+}
+
+sensorFrameView frameDecimator::getOutput(int output) const
+{
+	return outputs[output].view();
+}
@@ -0,0 +1,68 @@
+/*
+	Down-samples the frame stream for a subscriber that wants fewer
+	frames than the Aurora delivers.  Frames are gathered into windows
+	of a fixed number of frames, or of a target period of acquisition
+	time, and each window produces one frame: the latest, the average
+	of the sensors' poses, or a pair holding the per-axis minimum then
+	maximum of the positions.  Everything is sized by configure so
+	adding frames never allocates.
+*/
+
+#include "sensorFrame.h"
+#include <boost/cstdint.hpp>
+#include <vector>
+
+#pragma once
+
+// How a window of frames becomes one
+enum frameAggregation
+{
+	AGGREGATE_LATEST,		// The last frame of the window
+	AGGREGATE_AVERAGE,		// Mean position, normalised mean orientation and mean error of each sensor
+	AGGREGATE_MINMAX		// Two frames, the minimum then the maximum of each position axis and error
+};
+
+// What a subscriber asks for
+typedef struct frameDecimationStruct
+{
+	unsigned int factor;		// Frames per window, 0 to use rateHz instead
+	double rateHz;				// Windows per second of acquisition time
+	frameAggregation aggregation;
+} frameDecimation;
+
+class frameDecimator
+{
+
+public:
+	explicit frameDecimator(const frameDecimation &decimation);
+
+	// Size for numSensors and start a new window. Only call while nothing is adding frames
+	void configure(int numSensors);
+
+	// Returns the number of frames the window produced, 0 until it is complete
+	int addFrame(const sensorFrameView &view);
+	sensorFrameView getOutput(int output) const;
+
+private:
+	void clearWindow();
+	bool windowComplete(boost::int64_t acquisitionTime);
+	int aggregate();
+
+	frameDecimation decimation;
+	int numSensors;
+
+	unsigned int framesInWindow;
+	boost::int64_t windowStart;
+	boost::int64_t lastTime;
+	boost::int64_t frameInterval;			// Between the last two frames, so a window ends on the frame nearest its period
+
+	sensorFrameHeader lastHeader;
+	std::vector<sensorRecord> lastSensors;
+	std::vector<double> sums;				// Per sensor x, y, z, q0, qx, qy, qz, error
+	std::vector<unsigned int> counts;		// Poses in each sum
+	std::vector<unsigned int> statuses;		// Status bits of those poses or'd together
+	std::vector<sensorRecord> minimum;
+	std::vector<sensorRecord> maximum;
+
+	sensorFrame outputs[2];
+};
@@ -0,0 +1,250 @@
+#include "frameDispatcher.h"
+#include <iostream>
+
+frameDispatcher::frameDispatcher(broadcastRing &ring) : ring(ring)
+{
+	deliverCount = 0;
+	fullRateCount = 0;
+
+	for( int i = 0; i != MAX_FRAME_SUBSCRIPTIONS; ++i )
+	{
+		subscriptions[i].active = false;
+		subscriptions[i].executor = EXECUTE_DISPATCHER;
+		subscriptions[i].ringSubscriber = -1;
+		subscriptions[i].maxLag = 0;
+		subscriptions[i].mailboxDrops = 0;
+	}
+}
+
+int frameDispatcher::subscribe(const frameCallback &callback, frameExecutor executor, size_t maxLag, const frameDecimation *decimation)
+{
+	// Always inline then dispatch, the same order as unsubscribe
+	boost::lock_guard<boost::mutex> inlineLock(inlineMutex);
+	boost::lock_guard<boost::mutex> dispatchLock(dispatchMutex);
+
+	for( int i = 0; i != MAX_FRAME_SUBSCRIPTIONS; ++i )
+	{
+		frameSubscription &subscription = subscriptions[i];
+
+		if( subscription.active ) continue;
+
+		subscription.ringSubscriber = -1;
+		subscription.decimator.reset();
+		subscription.mailbox.reset();
+		subscription.mailboxDrops = 0;
+
+		if( decimation != NULL )
+		{
+			// Decimated frames come from the publishing thread, dispatcher ones through a mailbox
+			subscription.decimator.reset(new frameDecimator(*decimation));
+			subscription.decimator->configure(ring.getNumSensors());
+
+			if( executor == EXECUTE_DISPATCHER )
+			{
+				subscription.mailbox.reset(new frameRing(DECIMATED_QUEUE_SIZE));
+				subscription.mailbox->configure(ring.getNumSensors());
+			}
+		}
+		else if( executor == EXECUTE_DISPATCHER )
+		{
+			// Full rate dispatcher subscriptions need a cursor of their own
+			subscription.ringSubscriber = ring.subscribe();
+			if( subscription.ringSubscriber < 0 )
+			{
+				std::cout << "No free frame ring subscribers!" << std::endl;
+				return -1;
+			}
+		}
+
+		subscription.frameCopy.resize(ring.getNumSensors());
+		subscription.executor = executor;
+		subscription.callback = callback;
+		subscription.maxLag = maxLag < 1 ? 1 : ( maxLag > ring.getCapacity() ? ring.getCapacity() : maxLag );
+		subscription.active = true;
+
+		if( subscription.ringSubscriber >= 0 ) ++fullRateCount;
+		else ++deliverCount;
+
+		return i;
+	}
+
+	std::cout << "No free frame subscriptions!" << std::endl;
+	return -1;
+}
+
+void frameDispatcher::unsubscribe(int subscription)
+{
+	if( subscription < 0 || subscription >= MAX_FRAME_SUBSCRIPTIONS ) return;
+
+	boost::lock_guard<boost::mutex> inlineLock(inlineMutex);
+	boost::lock_guard<boost::mutex> dispatchLock(dispatchMutex);
+
+	frameSubscription &removed = subscriptions[subscription];
+
+	if( !removed.active ) return;
+
+	if( removed.ringSubscriber >= 0 )
+	{
+		ring.unsubscribe(removed.ringSubscriber);
+		--fullRateCount;
+	}
+	else
+	{
+		--deliverCount;
+	}
+
+	removed.active = false;
+	removed.ringSubscriber = -1;
+	removed.callback.clear();
+	removed.decimator.reset();
+	removed.mailbox.reset();
+}
+
+void frameDispatcher::configure()
+{
+	boost::lock_guard<boost::mutex> inlineLock(inlineMutex);
+	boost::lock_guard<boost::mutex> dispatchLock(dispatchMutex);
+
+	for( int i = 0; i != MAX_FRAME_SUBSCRIPTIONS; ++i )
+	{
+		frameSubscription &subscription = subscriptions[i];
+
+		if( !subscription.active ) continue;
+
+		if( subscription.decimator ) subscription.decimator->configure(ring.getNumSensors());
+		if( subscription.mailbox ) subscription.mailbox->configure(ring.getNumSensors());
+		subscription.frameCopy.resize(ring.getNumSensors());
+	}
+}
+
+unsigned long frameDispatcher::getOverruns(int subscription)
+{
+	if( subscription < 0 || subscription >= MAX_FRAME_SUBSCRIPTIONS ) return 0;
+
+	boost::lock_guard<boost::mutex> dispatchLock(dispatchMutex);
+
+	const frameSubscription &subscribed = subscriptions[subscription];
+
+	if( !subscribed.active ) return 0;
+	if( subscribed.ringSubscriber >= 0 ) return ring.getOverruns(subscribed.ringSubscriber);
+
+	return subscribed.mailboxDrops.load(boost::memory_order_relaxed);
+}
+
+void frameDispatcher::call(frameSubscription &subscription, const sensorFrameView &view)
+{
+	// A throwing callback mustn't take a thread down with it
+	try
+	{
+		subscription.callback(view);
+	}
+	catch( ... )
+	{
+		std::cout << "Frame callback threw an exception!" << std::endl;
+	}
+}
+
+bool frameDispatcher::deliver(const sensorFrameView &view)
+{
+	bool queued = false;
+
+	// Nothing to do, don't touch the mutex
+	if( deliverCount.load(boost::memory_order_relaxed) == 0 ) return false;
+
+	boost::lock_guard<boost::mutex> inlineLock(inlineMutex);
+
+	for( int i = 0; i != MAX_FRAME_SUBSCRIPTIONS; ++i )
+	{
+		frameSubscription &subscription = subscriptions[i];
+
+		if( !subscription.active || subscription.ringSubscriber >= 0 ) continue;
+
+		// Full rate inline
+		if( !subscription.decimator )
+		{
+			call(subscription, view);
+			continue;
+		}
+
+		// Down-sample once here, most frames stop at this point
+		int produced = subscription.decimator->addFrame(view);
+
+		for( int n = 0; n != produced; ++n )
+		{
+			sensorFrameView output = subscription.decimator->getOutput(n);
+
+			if( !subscription.mailbox )
+			{
+				call(subscription, output);
+			}
+			else if( subscription.mailbox->push(*output.header, output.sensors) )
+			{
+				queued = true;
+			}
+			else
+			{
+				subscription.mailboxDrops.fetch_add(1, boost::memory_order_relaxed);
+			}
+		}
+	}
+
+	return queued;
+}
+
+bool frameDispatcher::dispatch()
+{
+	boost::lock_guard<boost::mutex> dispatchLock(dispatchMutex);
+	bool delivered = false;
+
+	for( int i = 0; i != MAX_FRAME_SUBSCRIPTIONS; ++i )
+	{
+		frameSubscription &subscription = subscriptions[i];
+
+		if( !subscription.active || subscription.executor != EXECUTE_DISPATCHER ) continue;
+
+		// Decimated frames are copied out of the mailbox so the publishing thread can reuse the slot
+		if( subscription.mailbox )
+		{
+			for( int n = 0; n != DISPATCH_BATCH && subscription.mailbox->pop(subscription.frameCopy); ++n )
+			{
+				call(subscription, subscription.frameCopy.view());
+				delivered = true;
+			}
+			continue;
+		}
+
+		// Let a subscriber that has fallen behind catch up on the newest frames
+		ring.trimLag(subscription.ringSubscriber, subscription.maxLag);
+
+		// Copied out and checked before the call, so the writer can't change the frame under the callback.
+		// pop skips and counts any frame it overwrote during the copy
+		for( int n = 0; n != DISPATCH_BATCH && ring.pop(subscription.ringSubscriber, subscription.frameCopy); ++n )
+		{
+			call(subscription, subscription.frameCopy.view());
+			delivered = true;
+		}
+	}
+
+	return delivered;
+}
+
+bool frameDispatcher::dispatchPending()
+{
+	boost::lock_guard<boost::mutex> dispatchLock(dispatchMutex);
+
+	for( int i = 0; i != MAX_FRAME_SUBSCRIPTIONS; ++i )
+	{
+		const frameSubscription &subscription = subscriptions[i];
+
+		if( !subscription.active || subscription.executor != EXECUTE_DISPATCHER ) continue;
+
+		if( subscription.mailbox ? subscription.mailbox->read_available() > 0 : ring.getLag(subscription.ringSubscriber) > 0 ) return true;
+	}
+
+	return false;
+}
+
+bool frameDispatcher::hasFullRateSubscriptions() const
+{
+	return fullRateCount.load(boost::memory_order_relaxed) > 0;
+}
@@ -0,0 +1,106 @@
+/*
+	Frame callbacks.  A subscription either runs inline on the
+	thread publishing the frames, straight after it is read, or on a
+	dispatcher thread that follows the broadcast ring with its own
+	cursor.  Inline callbacks get a const view of the frame rather
+	than a copy.  Dispatcher callbacks get a view of a copy, taken and
+	checked against the writer before the call, so a frame the writer
+	overwrote while it was copied is counted as an overrun and never
+	delivered.  Inline callbacks must be quick as they hold
+	up the next request.  A dispatcher subscription that falls more
+	than maxLag frames behind skips the oldest ones, so a slow
+	callback costs that subscriber frames but never stalls the
+	acquisition.  Don't subscribe or unsubscribe from a callback.
+
+	A subscription can also ask for a decimated stream.  The publishing
+	thread then down-samples the frames once as they are published,
+	and only the frames that come out are handed on: called inline,
+	or queued in a small mailbox for the dispatcher, so a low rate
+	subscriber is only woken at its own rate.
+*/
+
+#include "sensorFrame.h"
+#include "broadcastRing.h"
+#include "frameRing.h"
+#include "frameDecimator.h"
+#include <boost/thread.hpp>
+#include <boost/function.hpp>
+#include <boost/atomic.hpp>
+#include <boost/array.hpp>
+#include <boost/shared_ptr.hpp>
+
+#pragma once
+
+// Most callbacks that can be registered at once
+const int MAX_FRAME_SUBSCRIPTIONS = 8;
+
+// Most frames a dispatcher subscription is given before the others get their turn
+const int DISPATCH_BATCH = 64;
+
+// Decimated frames waiting for the dispatcher, later ones are dropped and counted as overruns
+const size_t DECIMATED_QUEUE_SIZE = 64;
+
+typedef boost::function<void (const sensorFrameView &)> frameCallback;
+
+// Where a callback runs
+enum frameExecutor
+{
+	EXECUTE_INLINE,		// On the thread publishing the frames
+	EXECUTE_DISPATCHER	// On the dispatcher thread
+};
+
+typedef struct frameSubscriptionStruct
+{
+	bool active;
+	frameExecutor executor;
+	frameCallback callback;
+	int ringSubscriber;		// Cursor in the ring, undecimated dispatcher subscriptions only
+	size_t maxLag;
+	sensorFrame frameCopy;	// Dispatcher subscriptions, what the callback is given
+
+	// Decimated subscriptions only, the mailbox for the dispatcher ones
+	boost::shared_ptr<frameDecimator> decimator;
+	boost::shared_ptr<frameRing> mailbox;
+	boost::atomic<unsigned long> mailboxDrops;
+} frameSubscription;
+
+class frameDispatcher
+{
+
+public:
+	explicit frameDispatcher(broadcastRing &ring);
+
+	// Returns the subscription, or -1 if there are none free. Once unsubscribe returns the callback won't be called again.
+	// With a decimation the callback only gets the down-sampled frames, and maxLag is not used
+	int subscribe(const frameCallback &callback, frameExecutor executor, size_t maxLag, const frameDecimation *decimation = NULL);
+	void unsubscribe(int subscription);
+
+	// Size the decimated streams for the ring's sensors. Only call while nothing is publishing or dispatching
+	void configure();
+
+	// Frames a dispatcher subscription has lost, always 0 for inline ones
+	unsigned long getOverruns(int subscription);
+
+	// Publishing thread, one at a time in frame order. Call the inline callbacks and feed the decimators. Returns true if frames were queued for the dispatcher
+	bool deliver(const sensorFrameView &view);
+
+	// Dispatcher thread, one bounded pass over the dispatcher subscriptions. Returns true if any frame was delivered
+	bool dispatch();
+	bool dispatchPending();
+
+	// True if the dispatcher should be woken for every frame published
+	bool hasFullRateSubscriptions() const;
+
+private:
+	void call(frameSubscription &subscription, const sensorFrameView &view);
+
+	broadcastRing &ring;
+	boost::array<frameSubscription, MAX_FRAME_SUBSCRIPTIONS> subscriptions;
+
+	// Held while each kind of callback runs, so unsubscribing waits for a call in progress
+	boost::mutex inlineMutex;
+	boost::mutex dispatchMutex;
+
+	boost::atomic<int> deliverCount;	// Subscriptions the publishing thread has work for, inline or decimated
+	boost::atomic<int> fullRateCount;	// Undecimated dispatcher subscriptions
+};
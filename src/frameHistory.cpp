@@ -0,0 +1,285 @@
+#include "frameHistory.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+// Words in a frame's header: frame number, system status and acquisition time
+static const size_t HEADER_WORDS = 5;
+static const size_t WORDS_PER_SENSOR = sizeof(sensorRecord) / sizeof(boost::uint32_t);
+
+// Variable length integers, seven bits a byte, low bits first
+static void writeVarint(std::vector<unsigned char> &bytes, boost::uint32_t value)
+{
+	while( value >= 0x80 )
+	{
+		bytes.push_back((unsigned char)( value | 0x80 ));
+		value >>= 7;
+	}
+	bytes.push_back((unsigned char)value);
+}
+
+static boost::uint32_t readVarint(const unsigned char *&next)
+{
+	boost::uint32_t value = 0;
+	int shift = 0;
+
+	for(;;)
+	{
+		unsigned char byte = *next++;
+		value |= boost::uint32_t( byte & 0x7F ) << shift;
+		if( !( byte & 0x80 ) ) return value;
+		shift += 7;
+	}
+}
+
+frameHistory::frameHistory()
+{
+	configure(0, 0);
+}
+
+bool frameHistory::configure(int numSensors, size_t memoryBudget)
+{
+	boost::unique_lock<boost::shared_mutex> lock(historyMutex);
+
+	this->numSensors = numSensors;
+	this->memoryBudget = memoryBudget;
+	wordsPerFrame = HEADER_WORDS + numSensors * WORDS_PER_SENSOR;
+
+	// Whole chunks of uncompressed frames out of the budget, no budget or too small a one keeps no history
+	size_t chunkBytes = HISTORY_CHUNK_FRAMES * ( sizeof(sensorFrameHeader) + numSensors * sizeof(sensorRecord) );
+	size_t rawChunks = std::min(memoryBudget / HISTORY_RAW_SHARE / chunkBytes, HISTORY_RAW_CHUNKS);
+	bool fits = ( memoryBudget == 0 || memoryBudget >= chunkBytes );
+
+	if( rawChunks == 0 && fits && memoryBudget > 0 ) rawChunks = 1;
+	if( !fits ) std::cout << "History budget of " << memoryBudget << " bytes is under the " << chunkBytes << " needed for " << numSensors << " sensors, no history kept!" << std::endl;
+
+	rawCapacity = rawChunks * HISTORY_CHUNK_FRAMES;
+	rawHeaders.assign(rawCapacity, sensorFrameHeader());
+	rawRecords.assign(rawCapacity * numSensors, sensorRecord());
+	rawWritten = 0;
+	rawFirst = 0;
+
+	compressed.clear();
+	compressedBytes = 0;
+	compressedFrames = 0;
+	evictedFrames = 0;
+
+	previousWords.assign(wordsPerFrame, 0);
+	currentWords.assign(wordsPerFrame, 0);
+
+	return fits;
+}
+
+size_t frameHistory::getMemoryBudget() const
+{
+	return memoryBudget;
+}
+
+size_t frameHistory::rawBytes() const
+{
+	return rawHeaders.size() * sizeof(sensorFrameHeader) + rawRecords.size() * sizeof(sensorRecord);
+}
+
+void frameHistory::frameToWords(const sensorFrameHeader &header, const sensorRecord *sensors, boost::uint32_t *words) const
+{
+	boost::uint64_t frameNumber = header.frameNumber;
+	boost::uint64_t time = boost::uint64_t( header.acquisitionTime );
+
+	words[0] = boost::uint32_t( frameNumber );
+	words[1] = boost::uint32_t( frameNumber >> 32 );
+	words[2] = header.systemStatus;
+	words[3] = boost::uint32_t( time );
+	words[4] = boost::uint32_t( time >> 32 );
+
+	// Records are all 32 bit fields
+	if( numSensors > 0 ) std::memcpy(words + HEADER_WORDS, sensors, numSensors * sizeof(sensorRecord));
+}
+
+void frameHistory::wordsToFrame(const boost::uint32_t *words, sensorFrame &frame) const
+{
+	frame.resize(numSensors);
+	frame.header.frameNumber = (unsigned long)( words[0] | ( boost::uint64_t( words[1] ) << 32 ) );
+	frame.header.systemStatus = words[2];
+	frame.header.acquisitionTime = boost::int64_t( words[3] | ( boost::uint64_t( words[4] ) << 32 ) );
+	frame.header.numSensors = numSensors;
+
+	if( numSensors > 0 ) std::memcpy(&frame.sensors[0], words + HEADER_WORDS, numSensors * sizeof(sensorRecord));
+}
+
+void frameHistory::compressChunk(boost::uint64_t firstFrame, compressedChunk &chunk)
+{
+	chunk.frames = HISTORY_CHUNK_FRAMES;
+	chunk.bytes.clear();
+	chunk.bytes.reserve(HISTORY_CHUNK_FRAMES * wordsPerFrame);
+
+	// Each chunk starts from zeros so it can be read on its own
+	std::fill(previousWords.begin(), previousWords.end(), 0);
+
+	for( unsigned int n = 0; n != HISTORY_CHUNK_FRAMES; ++n )
+	{
+		size_t index = size_t( ( firstFrame + n ) % rawCapacity );
+		const sensorFrameHeader &header = rawHeaders[index];
+
+		if( n == 0 || header.frameNumber < chunk.minimumFrameNumber ) chunk.minimumFrameNumber = header.frameNumber;
+		if( n == 0 || header.frameNumber > chunk.maximumFrameNumber ) chunk.maximumFrameNumber = header.frameNumber;
+		if( n == 0 || header.acquisitionTime < chunk.minimumTime ) chunk.minimumTime = header.acquisitionTime;
+		if( n == 0 || header.acquisitionTime > chunk.maximumTime ) chunk.maximumTime = header.acquisitionTime;
+
+		frameToWords(header, numSensors > 0 ? &rawRecords[index * numSensors] : NULL, &currentWords[0]);
+
+		for( size_t w = 0; w != wordsPerFrame; ++w )
+		{
+			writeVarint(chunk.bytes, currentWords[w] ^ previousWords[w]);
+		}
+
+		previousWords.swap(currentWords);
+	}
+
+	// Give back what the reserve over-estimated
+	std::vector<unsigned char>(chunk.bytes).swap(chunk.bytes);
+}
+
+void frameHistory::addFrame(const sensorFrameView &view)
+{
+	if( rawCapacity == 0 ) return;
+
+	compressedChunk chunk;
+	bool haveChunk = false;
+
+	// About to overwrite the oldest raw chunk, compress it first. Only this thread writes the raw frames so no lock is needed to read them
+	if( rawWritten >= rawCapacity && rawWritten % HISTORY_CHUNK_FRAMES == 0 )
+	{
+		compressChunk(rawWritten - rawCapacity, chunk);
+		haveChunk = true;
+	}
+
+	boost::unique_lock<boost::shared_mutex> lock(historyMutex);
+
+	if( haveChunk )
+	{
+		rawFirst += HISTORY_CHUNK_FRAMES;
+		compressedBytes += chunk.bytes.size();
+		compressedFrames += chunk.frames;
+		compressed.push_back(compressedChunk());
+		compressed.back().bytes.swap(chunk.bytes);
+		compressed.back().frames = chunk.frames;
+		compressed.back().minimumFrameNumber = chunk.minimumFrameNumber;
+		compressed.back().maximumFrameNumber = chunk.maximumFrameNumber;
+		compressed.back().minimumTime = chunk.minimumTime;
+		compressed.back().maximumTime = chunk.maximumTime;
+
+		// Oldest go first once over budget
+		size_t raw = rawBytes();
+		while( !compressed.empty() && raw + compressedBytes > memoryBudget )
+		{
+			compressedBytes -= compressed.front().bytes.size();
+			compressedFrames -= compressed.front().frames;
+			evictedFrames += compressed.front().frames;
+			compressed.pop_front();
+		}
+	}
+
+	size_t index = size_t( rawWritten % rawCapacity );
+	rawHeaders[index] = *view.header;
+	rawHeaders[index].numSensors = numSensors;
+	if( numSensors > 0 ) std::memcpy(&rawRecords[index * numSensors], view.sensors, numSensors * sizeof(sensorRecord));
+	++rawWritten;
+}
+
+bool frameHistory::inRange(const sensorFrameHeader &header, bool byTime, boost::int64_t from, boost::int64_t to)
+{
+	if( byTime ) return header.acquisitionTime >= from && header.acquisitionTime <= to;
+
+	return boost::int64_t( header.frameNumber ) >= from && boost::int64_t( header.frameNumber ) <= to;
+}
+
+size_t frameHistory::query(bool byTime, boost::int64_t from, boost::int64_t to, std::vector<sensorFrame> &frames) const
+{
+	boost::shared_lock<boost::shared_mutex> lock(historyMutex);
+	size_t found = 0;
+	sensorFrame frame(numSensors);
+	std::vector<boost::uint32_t> words(wordsPerFrame, 0);
+
+	// Compressed chunks first, skipping any that can't hold the range
+	for( std::deque<compressedChunk>::const_iterator chunk = compressed.begin(); chunk != compressed.end(); ++chunk )
+	{
+		boost::int64_t minimum = byTime ? chunk->minimumTime : boost::int64_t( chunk->minimumFrameNumber );
+		boost::int64_t maximum = byTime ? chunk->maximumTime : boost::int64_t( chunk->maximumFrameNumber );
+		if( maximum < from || minimum > to ) continue;
+
+		const unsigned char *next = chunk->bytes.empty() ? NULL : &chunk->bytes[0];
+		std::fill(words.begin(), words.end(), 0);
+
+		for( unsigned int n = 0; n != chunk->frames; ++n )
+		{
+			for( size_t w = 0; w != wordsPerFrame; ++w )
+			{
+				words[w] ^= readVarint(next);
+			}
+
+			wordsToFrame(&words[0], frame);
+			if( inRange(frame.header, byTime, from, to) )
+			{
+				frames.push_back(frame);
+				++found;
+			}
+		}
+	}
+
+	// Then the raw frames that haven't been compressed
+	for( boost::uint64_t n = rawFirst; n != rawWritten; ++n )
+	{
+		size_t index = size_t( n % rawCapacity );
+
+		if( !inRange(rawHeaders[index], byTime, from, to) ) continue;
+
+		frame.header = rawHeaders[index];
+		if( numSensors > 0 ) std::memcpy(&frame.sensors[0], &rawRecords[index * numSensors], numSensors * sizeof(sensorRecord));
+		frames.push_back(frame);
+		++found;
+	}
+
+	return found;
+}
+
+size_t frameHistory::getFramesByNumber(unsigned long firstFrame, unsigned long lastFrame, std::vector<sensorFrame> &frames) const
+{
+	return query(false, firstFrame, lastFrame, frames);
+}
+
+size_t frameHistory::getFramesByTime(boost::int64_t fromTime, boost::int64_t toTime, std::vector<sensorFrame> &frames) const
+{
+	return query(true, fromTime, toTime, frames);
+}
+
+void frameHistory::getInfo(historyInfo &info) const
+{
+	boost::shared_lock<boost::shared_mutex> lock(historyMutex);
+
+	info.rawFrames = size_t( rawWritten - rawFirst );
+	info.frames = info.rawFrames + compressedFrames;
+	info.compressedChunks = compressed.size();
+	info.bytesUsed = rawBytes() + compressedBytes;
+	info.memoryBudget = memoryBudget;
+	info.evictedFrames = evictedFrames;
+	info.oldestFrameNumber = info.newestFrameNumber = 0;
+	info.oldestTime = info.newestTime = 0;
+
+	if( info.rawFrames == 0 ) return;
+
+	const sensorFrameHeader &newest = rawHeaders[size_t( ( rawWritten - 1 ) % rawCapacity )];
+	info.newestFrameNumber = newest.frameNumber;
+	info.newestTime = newest.acquisitionTime;
+
+	if( !compressed.empty() )
+	{
+		info.oldestFrameNumber = compressed.front().minimumFrameNumber;
+		info.oldestTime = compressed.front().minimumTime;
+	}
+	else
+	{
+		const sensorFrameHeader &oldest = rawHeaders[size_t( rawFirst % rawCapacity )];
+		info.oldestFrameNumber = oldest.frameNumber;
+		info.oldestTime = oldest.acquisitionTime;
+	}
+}
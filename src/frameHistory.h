@@ -0,0 +1,98 @@
+/*
+	In-memory history of the session that can be queried without
+	consuming it.  The newest frames are kept as they are, in up to a
+	few chunks of frames taking at most half the memory budget.  When the oldest of those is needed again it is
+	compressed: each frame is XOR'd word by word with the frame before
+	it and the result written as variable length integers, so values
+	that hardly change between frames take a byte or two.  Compressed
+	chunks are dropped oldest first to stay within the memory budget.
+	Frames can be read back by frame number or by acquisition time.
+*/
+
+#include "sensorFrame.h"
+#include <boost/thread.hpp>
+#include <boost/cstdint.hpp>
+#include <deque>
+#include <vector>
+
+#pragma once
+
+// History constants
+const unsigned int HISTORY_CHUNK_FRAMES = 256;		// Frames in each chunk, about 6 s at 40 Hz
+const size_t HISTORY_RAW_CHUNKS = 4;				// Most chunks of the newest frames kept uncompressed
+const size_t HISTORY_RAW_SHARE = 2;					// Uncompressed frames take at most 1 / HISTORY_RAW_SHARE of the budget
+
+// What the history holds
+typedef struct historyInfoStruct
+{
+	size_t frames;
+	size_t rawFrames;					// Of those, uncompressed
+	size_t compressedChunks;
+	size_t bytesUsed;
+	size_t memoryBudget;
+	unsigned long oldestFrameNumber;
+	unsigned long newestFrameNumber;
+	boost::int64_t oldestTime;			// Acquisition times, steady clock nanoseconds
+	boost::int64_t newestTime;
+	unsigned long evictedFrames;		// Dropped to stay within the budget
+} historyInfo;
+
+class frameHistory
+{
+
+public:
+	frameHistory();
+
+	// Size for numSensors and a memory budget in bytes, 0 keeps no history, and clear it. Only call while nothing is adding frames.
+	// Returns false, keeping no history, if the budget doesn't hold one chunk of frames as they are
+	bool configure(int numSensors, size_t memoryBudget);
+	size_t getMemoryBudget() const;
+
+	// One thread only
+	void addFrame(const sensorFrameView &view);
+
+	// Any thread. Appends the frames in the inclusive range, oldest first, and returns how many
+	size_t getFramesByNumber(unsigned long firstFrame, unsigned long lastFrame, std::vector<sensorFrame> &frames) const;
+	size_t getFramesByTime(boost::int64_t fromTime, boost::int64_t toTime, std::vector<sensorFrame> &frames) const;
+	void getInfo(historyInfo &info) const;
+
+private:
+	typedef struct compressedChunkStruct
+	{
+		unsigned int frames;
+		unsigned long minimumFrameNumber, maximumFrameNumber;
+		boost::int64_t minimumTime, maximumTime;
+		std::vector<unsigned char> bytes;
+	} compressedChunk;
+
+	size_t query(bool byTime, boost::int64_t from, boost::int64_t to, std::vector<sensorFrame> &frames) const;
+	static bool inRange(const sensorFrameHeader &header, bool byTime, boost::int64_t from, boost::int64_t to);
+
+	void frameToWords(const sensorFrameHeader &header, const sensorRecord *sensors, boost::uint32_t *words) const;
+	void wordsToFrame(const boost::uint32_t *words, sensorFrame &frame) const;
+	void compressChunk(boost::uint64_t firstFrame, compressedChunk &chunk);
+	size_t rawBytes() const;
+
+	int numSensors;
+	size_t wordsPerFrame;
+	size_t memoryBudget;
+
+	// Newest frames, frame n of the session is at n % rawCapacity
+	size_t rawCapacity;
+	std::vector<sensorFrameHeader> rawHeaders;
+	std::vector<sensorRecord> rawRecords;
+	boost::uint64_t rawWritten;
+	boost::uint64_t rawFirst;			// Oldest raw frame not yet compressed
+
+	std::deque<compressedChunk> compressed;
+	size_t compressedBytes;
+	size_t compressedFrames;
+	unsigned long evictedFrames;
+
+	// Scratch for the writer
+	std::vector<boost::uint32_t> previousWords;
+	std::vector<boost::uint32_t> currentWords;
+
+	// Queries share it, adding a frame or a chunk takes it alone
+	mutable boost::shared_mutex historyMutex;
+};
@@ -0,0 +1,316 @@
+#include "framePipeline.h"
+#include <boost/chrono.hpp>
+#include <cstring>
+
+framePipeline::framePipeline(size_t depth) : depth(depth)
+{
+	threads = 0;
+	idleWorkers = 0;
+	stopFlag = false;
+	configure(0);
+}
+
+framePipeline::~framePipeline()
+{
+	stop();
+}
+
+int framePipeline::addStage(const pipelineStage &stage)
+{
+	if( stages.size() == MAX_PIPELINE_STAGES ) return -1;
+
+	stages.push_back(stage);
+	return int(stages.size()) - 1;
+}
+
+void framePipeline::configure(int numSensors)
+{
+	this->numSensors = numSensors;
+
+	// All the frames are allocated here, submitting only copies into them
+	slots.resize(depth);
+	for( size_t i = 0; i != depth; ++i )
+	{
+		slots[i].frame.resize(numSensors);
+		slots[i].flags = 0;
+		slots[i].sequence = 0;
+	}
+	stagesDone.assign(depth, 0);
+
+	submitted = 0;
+	completed = 0;
+	stageNext.fill(0);
+	nextQueue = 0;
+	queuedTasks = 0;
+	steals = 0;
+	stalls = 0;
+	stallMs = 0.0;
+	longestStallMs = 0.0;
+}
+
+void framePipeline::start(int threads)
+{
+	stop();
+
+	if( threads < 0 ) threads = 0;
+	if( threads > MAX_PIPELINE_THREADS ) threads = MAX_PIPELINE_THREADS;
+
+	// Number the frames and count afresh
+	{
+		boost::lock_guard<boost::mutex> lock(scheduleMutex);
+		submitted = 0;
+		completed = 0;
+		stageNext.fill(0);
+		stagesDone.assign(depth, 0);
+		steals = 0;
+		stalls = 0;
+		stallMs = 0.0;
+		longestStallMs = 0.0;
+	}
+
+	stopFlag.store(false, boost::memory_order_release);
+	this->threads = threads;
+
+	for( int i = 0; i != threads; ++i )
+	{
+		workerThreads[i] = boost::thread(&framePipeline::runWorker, this, i);
+	}
+}
+
+void framePipeline::stop()
+{
+	if( threads == 0 ) return;
+
+	// Let everything submitted finish first
+	{
+		boost::unique_lock<boost::mutex> lock(scheduleMutex);
+		while( completed != submitted )
+		{
+			spaceCondition.wait(lock);
+		}
+	}
+
+	// Set under the mutex so the wake up can't be missed by a thread about to wait
+	{
+		boost::lock_guard<boost::mutex> lock(idleMutex);
+		stopFlag.store(true, boost::memory_order_release);
+		idleCondition.notify_all();
+	}
+
+	for( int i = 0; i != threads; ++i )
+	{
+		workerThreads[i].join();
+	}
+
+	threads = 0;
+}
+
+void framePipeline::submit(const sensorFrameHeader &header, const sensorRecord *sensors)
+{
+	// No threads, the stages run here
+	if( threads == 0 )
+	{
+		pipelineFrame &frame = slots[0];
+		frame.frame.header = header;
+		frame.frame.header.numSensors = numSensors;
+		if( numSensors > 0 ) std::memcpy(&frame.frame.sensors[0], sensors, numSensors * sizeof(sensorRecord));
+		frame.flags = 0;
+		frame.sequence = submitted;
+
+		for( size_t i = 0; i != stages.size(); ++i )
+		{
+			stages[i](frame);
+		}
+
+		boost::lock_guard<boost::mutex> lock(scheduleMutex);
+		++submitted;
+		++completed;
+		return;
+	}
+
+	boost::uint64_t sequence;
+
+	// Backpressure, wait for the oldest frame to get through when all the slots are in use
+	{
+		boost::unique_lock<boost::mutex> lock(scheduleMutex);
+
+		if( submitted - completed >= depth )
+		{
+			boost::chrono::steady_clock::time_point stallStart = boost::chrono::steady_clock::now();
+
+			while( submitted - completed >= depth )
+			{
+				spaceCondition.wait(lock);
+			}
+
+			double ms = boost::chrono::duration<double, boost::milli>(boost::chrono::steady_clock::now() - stallStart).count();
+			++stalls;
+			stallMs += ms;
+			if( ms > longestStallMs ) longestStallMs = ms;
+		}
+
+		sequence = submitted;
+	}
+
+	// Nothing reads a slot until it is submitted, so it is filled without the lock
+	size_t slot = size_t( sequence % depth );
+	pipelineFrame &frame = slots[slot];
+	frame.frame.header = header;
+	frame.frame.header.numSensors = numSensors;
+	if( numSensors > 0 ) std::memcpy(&frame.frame.sensors[0], sensors, numSensors * sizeof(sensorRecord));
+	frame.flags = 0;
+	frame.sequence = sequence;
+
+	bool ready;
+	{
+		boost::lock_guard<boost::mutex> lock(scheduleMutex);
+		stagesDone[slot] = 0;
+		++submitted;
+
+		// The first stage may still be busy with earlier frames, it picks this one up when it finishes them
+		ready = ( stageNext[0] == sequence );
+	}
+
+	if( ready )
+	{
+		pipelineTask task = { slot, 0 };
+		pushTask(nextQueue, task);
+		nextQueue = ( nextQueue + 1 ) % threads;
+	}
+}
+
+void framePipeline::pushTask(int worker, const pipelineTask &task)
+{
+	// Counted first so a thread that finds the task can't take the count below zero
+	queuedTasks.fetch_add(1, boost::memory_order_release);
+
+	{
+		boost::lock_guard<boost::mutex> lock(queues[worker].mutex);
+		queues[worker].tasks.push_back(task);
+	}
+
+	boost::lock_guard<boost::mutex> lock(idleMutex);
+	if( idleWorkers > 0 ) idleCondition.notify_one();
+}
+
+bool framePipeline::takeTask(int worker, pipelineTask &task)
+{
+	// Own newest first, its frame is most likely still in this core's cache
+	{
+		boost::lock_guard<boost::mutex> lock(queues[worker].mutex);
+		if( !queues[worker].tasks.empty() )
+		{
+			task = queues[worker].tasks.back();
+			queues[worker].tasks.pop_back();
+			queuedTasks.fetch_sub(1, boost::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	// Then the oldest of another thread's
+	for( int i = 1; i != threads; ++i )
+	{
+		workerQueue &victim = queues[( worker + i ) % threads];
+
+		boost::lock_guard<boost::mutex> lock(victim.mutex);
+		if( !victim.tasks.empty() )
+		{
+			task = victim.tasks.front();
+			victim.tasks.pop_front();
+			queuedTasks.fetch_sub(1, boost::memory_order_relaxed);
+			steals.fetch_add(1, boost::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void framePipeline::completeTask(int worker, const pipelineTask &task)
+{
+	pipelineTask ready[2];
+	int readyCount = 0;
+
+	{
+		boost::lock_guard<boost::mutex> lock(scheduleMutex);
+
+		boost::uint64_t sequence = slots[task.slot].sequence;
+		stagesDone[task.slot] = task.stage + 1;
+		stageNext[task.stage] = sequence + 1;
+
+		// The next frame may be waiting for this stage
+		if( sequence + 1 < submitted )
+		{
+			size_t next = size_t( ( sequence + 1 ) % depth );
+			if( stagesDone[next] == task.stage )
+			{
+				pipelineTask nextFrame = { next, task.stage };
+				ready[readyCount++] = nextFrame;
+			}
+		}
+
+		// This frame moves on to the next stage if that has finished the frame before, pushed last so this thread takes it
+		if( task.stage + 1 < int(stages.size()) )
+		{
+			if( stageNext[task.stage + 1] == sequence )
+			{
+				pipelineTask nextStage = { task.slot, task.stage + 1 };
+				ready[readyCount++] = nextStage;
+			}
+		}
+		else
+		{
+			// Through every stage, the slot is free
+			++completed;
+			spaceCondition.notify_all();
+		}
+	}
+
+	for( int i = 0; i != readyCount; ++i )
+	{
+		pushTask(worker, ready[i]);
+	}
+}
+
+void framePipeline::runWorker(int worker)
+{
+	for(;;)
+	{
+		pipelineTask task;
+
+		if( takeTask(worker, task) )
+		{
+			stages[task.stage](slots[task.slot]);
+			completeTask(worker, task);
+			continue;
+		}
+
+		// Nothing anywhere, sleep until a task is queued or we are told to stop
+		boost::unique_lock<boost::mutex> lock(idleMutex);
+		if( queuedTasks.load(boost::memory_order_acquire) > 0 ) continue;
+		if( stopFlag.load(boost::memory_order_acquire) ) break;
+
+		++idleWorkers;
+		while( queuedTasks.load(boost::memory_order_acquire) == 0 && !stopFlag.load(boost::memory_order_acquire) )
+		{
+			idleCondition.wait(lock);
+		}
+		--idleWorkers;
+	}
+}
+
+void framePipeline::getStatistics(pipelineStatistics &statistics) const
+{
+	boost::lock_guard<boost::mutex> lock(scheduleMutex);
+
+	statistics.threads = threads;
+	statistics.stages = int(stages.size());
+	statistics.submitted = (unsigned long)submitted;
+	statistics.completed = (unsigned long)completed;
+	statistics.inFlight = size_t( submitted - completed );
+	statistics.depth = depth;
+	statistics.steals = steals.load(boost::memory_order_relaxed);
+	statistics.stalls = stalls;
+	statistics.stallMs = stallMs;
+	statistics.longestStallMs = longestStallMs;
+}
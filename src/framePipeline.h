@@ -0,0 +1,122 @@
+/*
+	Post-processing of the frames off the tracking thread.  Each frame
+	goes through a fixed list of stages, in order, and each stage sees
+	the frames in the order they were submitted, so stages may keep
+	state from one frame to the next.  Different stages work on
+	different frames at once on a small pool of threads.  Each thread
+	keeps its own queue of ready work and takes from the others' when
+	it runs dry.  Only a fixed number of frames can be in flight; past
+	that, submitting waits for the oldest to finish.
+*/
+
+#include "sensorFrame.h"
+#include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+#include <boost/array.hpp>
+#include <boost/cstdint.hpp>
+#include <deque>
+#include <vector>
+
+#pragma once
+
+// Pipeline constants
+const int MAX_PIPELINE_STAGES = 8;
+const int MAX_PIPELINE_THREADS = 8;
+
+// A frame on its way through the stages
+typedef struct pipelineFrameStruct
+{
+	sensorFrame frame;
+	unsigned int flags;				// For the stages to pass things on to the later ones, cleared on submit
+	boost::uint64_t sequence;		// Submission order
+} pipelineFrame;
+
+typedef boost::function<void(pipelineFrame &)> pipelineStage;
+
+// Pipeline counters
+typedef struct pipelineStatisticsStruct
+{
+	int threads;					// 0 runs every stage on the submitting thread
+	int stages;
+	unsigned long submitted;
+	unsigned long completed;		// Frames through every stage
+	size_t inFlight;
+	size_t depth;
+	unsigned long steals;			// Tasks a thread took from another's queue
+	unsigned long stalls;			// Submits that waited for room
+	double stallMs;
+	double longestStallMs;
+} pipelineStatistics;
+
+class framePipeline
+{
+
+public:
+	explicit framePipeline(size_t depth);
+	~framePipeline();
+
+	// Stages run in the order added. Only while stopped, returns the stage number or -1 if there are too many
+	int addStage(const pipelineStage &stage);
+
+	// Size the frames for numSensors. Only while stopped
+	void configure(int numSensors);
+
+	// Start the threads, 0 runs the stages on the submitting thread. Stopping waits for every frame submitted to finish
+	void start(int threads);
+	void stop();
+
+	// One thread only. Waits while depth frames are in flight
+	void submit(const sensorFrameHeader &header, const sensorRecord *sensors);
+
+	void getStatistics(pipelineStatistics &statistics) const;
+
+private:
+	typedef struct pipelineTaskStruct
+	{
+		size_t slot;
+		int stage;
+	} pipelineTask;
+
+	typedef struct workerQueueStruct
+	{
+		boost::mutex mutex;
+		std::deque<pipelineTask> tasks;
+	} workerQueue;
+
+	void runWorker(int worker);
+	bool takeTask(int worker, pipelineTask &task);
+	void pushTask(int worker, const pipelineTask &task);
+	void completeTask(int worker, const pipelineTask &task);
+
+	size_t depth;
+	int numSensors;
+	std::vector<pipelineFrame> slots;	// Frame n is in slot n % depth
+	std::vector<pipelineStage> stages;
+
+	// Scheduling, under scheduleMutex. A frame's stage is ready once the frame has been through the stage before
+	// it and the stage has finished the frame before
+	boost::uint64_t submitted;
+	boost::uint64_t completed;
+	std::vector<int> stagesDone;		// Per slot
+	boost::array<boost::uint64_t, MAX_PIPELINE_STAGES> stageNext;	// Next frame for each stage
+	mutable boost::mutex scheduleMutex;
+	boost::condition_variable spaceCondition;	// Signalled as frames complete
+
+	// Threads and their queues, a thread takes its own newest task first and steals others' oldest
+	int threads;
+	workerQueue queues[MAX_PIPELINE_THREADS];
+	boost::thread workerThreads[MAX_PIPELINE_THREADS];
+	int nextQueue;
+	boost::atomic<int> queuedTasks;
+	boost::atomic<bool> stopFlag;
+	int idleWorkers;
+	boost::mutex idleMutex;
+	boost::condition_variable idleCondition;
+
+	// Counters
+	boost::atomic<unsigned long> steals;
+	unsigned long stalls;
+	double stallMs;
+	double longestStallMs;
+};
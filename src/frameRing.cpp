@@ -0,0 +1,112 @@
+#include "frameRing.h"
+#include <cstring>
+
+frameRing::frameRing(size_t capacity) : capacity(capacity)
+{
+	configure(0);
+}
+
+void frameRing::configure(int numSensors)
+{
+	this->numSensors = numSensors;
+
+	// Header then the records, rounded up to whole words
+	size_t slotBytes = sizeof(sensorFrameHeader) + numSensors * sizeof(sensorRecord);
+	slotWords = ( slotBytes + sizeof(boost::uint64_t) - 1 ) / sizeof(boost::uint64_t);
+
+	storage.assign(capacity * slotWords, 0);
+
+	writeCount = 0;
+	readCount = 0;
+}
+
+int frameRing::getNumSensors() const
+{
+	return numSensors;
+}
+
+size_t frameRing::getCapacity() const
+{
+	return capacity;
+}
+
+boost::uint64_t *frameRing::slotAt(size_t count)
+{
+	return &storage[( count % capacity ) * slotWords];
+}
+
+bool frameRing::push(const sensorFrameHeader &header, const sensorRecord *sensors)
+{
+	size_t head = writeCount.load(boost::memory_order_relaxed);
+
+	// Full, the consumer hasn't freed a slot
+	if( head - readCount.load(boost::memory_order_acquire) >= capacity ) return false;
+
+	boost::uint64_t *slot = slotAt(head);
+
+	sensorFrameHeader *slotHeader = reinterpret_cast<sensorFrameHeader *>(slot);
+	*slotHeader = header;
+	slotHeader->numSensors = numSensors;
+	std::memcpy(slotHeader + 1, sensors, numSensors * sizeof(sensorRecord));
+
+	// Publish the slot
+	writeCount.store(head + 1, boost::memory_order_release);
+	return true;
+}
+
+bool frameRing::pop(sensorFrame &frame)
+{
+	size_t tail = readCount.load(boost::memory_order_relaxed);
+
+	// Empty
+	if( tail == writeCount.load(boost::memory_order_acquire) ) return false;
+
+	const sensorFrameHeader *slotHeader = reinterpret_cast<const sensorFrameHeader *>(slotAt(tail));
+
+	frame.header = *slotHeader;
+	frame.resize(numSensors);
+	if( numSensors > 0 ) std::memcpy(&frame.sensors[0], slotHeader + 1, numSensors * sizeof(sensorRecord));
+
+	// Hand the slot back to the producer
+	readCount.store(tail + 1, boost::memory_order_release);
+	return true;
+}
+
+bool frameRing::peek(sensorFrameView &view)
+{
+	size_t tail = readCount.load(boost::memory_order_relaxed);
+
+	// Empty
+	if( tail == writeCount.load(boost::memory_order_acquire) ) return false;
+
+	const sensorFrameHeader *slotHeader = reinterpret_cast<const sensorFrameHeader *>(slotAt(tail));
+	view.header = slotHeader;
+	view.sensors = reinterpret_cast<const sensorRecord *>(slotHeader + 1);
+	return true;
+}
+
+void frameRing::release()
+{
+	readCount.store(readCount.load(boost::memory_order_relaxed) + 1, boost::memory_order_release);
+}
+
+size_t frameRing::trimLag(size_t maxLag)
+{
+	size_t tail = readCount.load(boost::memory_order_relaxed);
+	size_t unread = writeCount.load(boost::memory_order_acquire) - tail;
+
+	if( unread <= maxLag ) return 0;
+
+	readCount.store(tail + unread - maxLag, boost::memory_order_release);
+	return unread - maxLag;
+}
+
+size_t frameRing::read_available() const
+{
+	return writeCount.load(boost::memory_order_acquire) - readCount.load(boost::memory_order_relaxed);
+}
+
+void frameRing::prefault()
+{
+	if( !storage.empty() ) std::memset(&storage[0], 0, storage.size() * sizeof(boost::uint64_t));
+}
@@ -0,0 +1,53 @@
+/*
+	Single producer, single consumer ring buffer of frames.  All the
+	frames are stored back to back in one block allocated by
+	configure(), with a stride set by the number of sensors, so
+	pushing and popping never allocate.
+*/
+
+#include "sensorFrame.h"
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <vector>
+
+#pragma once
+
+class frameRing
+{
+
+public:
+	explicit frameRing(size_t capacity);
+
+	// Size the slots for numSensors and empty the ring. Only call while neither side is running
+	void configure(int numSensors);
+	int getNumSensors() const;
+	size_t getCapacity() const;
+
+	// Producer side
+	bool push(const sensorFrameHeader &header, const sensorRecord *sensors);
+
+	// Consumer side
+	bool pop(sensorFrame &frame);
+	size_t read_available() const;
+
+	// Zero copy read of the oldest frame, the slot stays put until release() hands it back to the producer
+	bool peek(sensorFrameView &view);
+	void release();
+
+	// Skip the oldest frames so at most maxLag are left, returns the number skipped
+	size_t trimLag(size_t maxLag);
+
+	// Write to every slot so the pages are resident before time critical use. Only call while stopped
+	void prefault();
+
+private:
+	boost::uint64_t *slotAt(size_t count);
+
+	size_t capacity;
+	int numSensors;
+	size_t slotWords;					// Slot size in 8 byte words, keeps every header aligned
+	std::vector<boost::uint64_t> storage;
+
+	boost::atomic<size_t> writeCount;	// Frames ever pushed, only the producer writes it
+	boost::atomic<size_t> readCount;	// Frames ever popped, only the consumer writes it
+};
@@ -0,0 +1,96 @@
+#include "frameScheduler.h"
+
+frameScheduler::frameScheduler()
+{
+	reset();
+}
+
+void frameScheduler::reset()
+{
+	haveFrame = false;
+	lastFrameNumber = 0;
+	framePeriodMs = 0;
+	periodSamples = 0;
+	nextRequest = boost::chrono::steady_clock::now();
+
+	locked = false;
+	framePeriodUs = 0;
+	newFrames = 0;
+	duplicateFrames = 0;
+}
+
+bool frameScheduler::frameReceived(unsigned long frameNumber, schedulerTime requestTime, schedulerTime receiveTime)
+{
+	typedef boost::chrono::duration<double, boost::milli> milliseconds;
+
+	if( haveFrame && frameNumber == lastFrameNumber )
+	{
+		++duplicateFrames;
+
+		// Requested too early, try again a fraction of a frame later
+		nextRequest = receiveTime;
+		if( locked ) nextRequest += boost::chrono::duration_cast<boost::chrono::steady_clock::duration>(milliseconds(framePeriodMs / 10));
+		return false;
+	}
+
+	if( haveFrame )
+	{
+		// The frame counter is 32 bits on the wire, allow for it wrapping
+		unsigned long framesElapsed = ( frameNumber - lastFrameNumber ) & 0xFFFFFFFFUL;
+		double sampleMs = milliseconds(receiveTime - lastFrameTime).count() / double(framesElapsed);
+
+		// Reject samples across a stall or a counter reset
+		if( framesElapsed > 0 && sampleMs >= MIN_FRAME_PERIOD_MS && sampleMs <= MAX_FRAME_PERIOD_MS )
+		{
+			if( periodSamples == 0 ) framePeriodMs = sampleMs;
+			else framePeriodMs += FRAME_PERIOD_FILTER * ( sampleMs - framePeriodMs );
+
+			if( ++periodSamples >= FRAME_PERIOD_SAMPLES ) locked = true;
+			framePeriodUs = long(framePeriodMs * 1000);
+		}
+	}
+
+	haveFrame = true;
+	lastFrameNumber = frameNumber;
+	lastFrameTime = receiveTime;
+	anchorTime = requestTime;
+	++newFrames;
+
+	// The next frame is ready one period after this one was, aim just ahead of that and let duplicates walk the phase forward
+	if( locked )
+	{
+		nextRequest = anchorTime + boost::chrono::duration_cast<boost::chrono::steady_clock::duration>(milliseconds(framePeriodMs * 0.95));
+	}
+	else
+	{
+		// Back to back until the period is known
+		nextRequest = receiveTime;
+	}
+
+	return true;
+}
+
+schedulerTime frameScheduler::nextRequestTime() const
+{
+	return nextRequest;
+}
+
+bool frameScheduler::isLocked() const
+{
+	return locked;
+}
+
+double frameScheduler::getFramePeriodMs() const
+{
+	return framePeriodUs / 1000.0;
+}
+
+unsigned long frameScheduler::getNewFrames() const
+{
+	return newFrames;
+}
+
+unsigned long frameScheduler::getDuplicateFrames() const
+{
+	return duplicateFrames;
+}
@@ -0,0 +1,57 @@
+/*
+	Schedules BX requests to the Aurora's measurement rate.  The frame
+	period is learnt from the device frame numbers and host receive
+	times, and each request is timed to arrive just after the next
+	frame should be ready.  Replies that repeat a frame number already
+	seen are reported as duplicates so they can be dropped.
+*/
+
+#include <boost/atomic.hpp>
+#include <boost/chrono.hpp>
+
+#pragma once
+
+// Scheduler constants
+const int FRAME_PERIOD_SAMPLES = 4;			// New frames needed before requests are phase-locked
+const double FRAME_PERIOD_FILTER = 0.05;	// Weight of each new sample in the period estimate
+const double MIN_FRAME_PERIOD_MS = 1.0;		// Samples outside this range are rejected
+const double MAX_FRAME_PERIOD_MS = 1000.0;
+
+typedef boost::chrono::steady_clock::time_point schedulerTime;
+
+class frameScheduler
+{
+
+public:
+	frameScheduler();
+
+	// Forget the learnt period, call before tracking starts
+	void reset();
+
+	// Record the frame number of a reply, returns true if the frame is new
+	bool frameReceived(unsigned long frameNumber, schedulerTime requestTime, schedulerTime receiveTime);
+
+	// When the next BX should be sent
+	schedulerTime nextRequestTime() const;
+
+	// Statistics, safe to read from any thread
+	bool isLocked() const;
+	double getFramePeriodMs() const;
+	unsigned long getNewFrames() const;
+	unsigned long getDuplicateFrames() const;
+
+private:
+	bool haveFrame;
+	unsigned long lastFrameNumber;
+	schedulerTime lastFrameTime;		// Receive time of the last new frame
+	schedulerTime anchorTime;			// Request time that first returned the last new frame
+	schedulerTime nextRequest;
+
+	double framePeriodMs;
+	int periodSamples;
+
+	boost::atomic<bool> locked;
+	boost::atomic<long> framePeriodUs;
+	boost::atomic<unsigned long> newFrames;
+	boost::atomic<unsigned long> duplicateFrames;
+};
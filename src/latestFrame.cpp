@@ -0,0 +1,109 @@
+#include "latestFrame.h"
+#include <cstring>
+
+latestFrame::latestFrame()
+{
+	waiters = 0;
+	configure(0);
+}
+
+void latestFrame::configure(int numSensors)
+{
+	this->numSensors = numSensors;
+	sensors.assign(numSensors, sensorRecord());
+
+	header.frameNumber = 0;
+	header.systemStatus = 0;
+	header.acquisitionTime = 0;
+	header.numSensors = numSensors;
+
+	// Nothing published yet. The sequence carries on, so a count read before can't be mistaken for a later frame
+	emptySequence = lock.readBegin();
+}
+
+int latestFrame::getNumSensors() const
+{
+	return numSensors;
+}
+
+void latestFrame::publish(const sensorFrameHeader &header, const sensorRecord *sensors)
+{
+	lock.writeBegin();
+
+	this->header = header;
+	this->header.numSensors = numSensors;
+	if( numSensors > 0 ) std::memcpy(&this->sensors[0], sensors, numSensors * sizeof(sensorRecord));
+
+	lock.writeEnd();
+
+	// Only wake sleepers if there are any, the sequential consistency of writeEnd pairs with the waiter's count
+	if( waiters.load(boost::memory_order_seq_cst) > 0 )
+	{
+		boost::lock_guard<boost::mutex> guard(waitMutex);
+		waitCondition.notify_all();
+	}
+}
+
+bool latestFrame::read(sensorFrame &frame) const
+{
+	boost::uint64_t sequence;
+
+	return read(frame, sequence);
+}
+
+bool latestFrame::read(sensorFrame &frame, boost::uint64_t &sequence) const
+{
+	boost::uint64_t begin;
+
+	frame.resize(numSensors);
+
+	do
+	{
+		begin = lock.readBegin();
+
+		frame.header = header;
+		if( numSensors > 0 ) std::memcpy(&frame.sensors[0], &sensors[0], numSensors * sizeof(sensorRecord));
+	}
+	while( lock.readRetry(begin) );
+
+	// Two steps of the lock a publish
+	sequence = begin / 2;
+
+	return begin != emptySequence;
+}
+
+bool latestFrame::readNewer(boost::uint64_t &sequence, sensorFrame &frame) const
+{
+	boost::uint64_t published;
+
+	if( !read(frame, published) || published <= sequence ) return false;
+
+	sequence = published;
+	return true;
+}
+
+bool latestFrame::waitForNewer(boost::uint64_t &sequence, sensorFrame &frame, unsigned int msTimeout)
+{
+	// Most of the time there is already a newer frame
+	if( readNewer(sequence, frame) ) return true;
+
+	boost::chrono::steady_clock::time_point deadline = boost::chrono::steady_clock::now() + boost::chrono::milliseconds(msTimeout);
+	boost::unique_lock<boost::mutex> guard(waitMutex);
+	bool newer = false;
+
+	// Count ourselves before checking again so a publish in between can't be missed
+	waiters.fetch_add(1, boost::memory_order_seq_cst);
+
+	while( !( newer = readNewer(sequence, frame) ) )
+	{
+		if( waitCondition.wait_until(guard, deadline) == boost::cv_status::timeout )
+		{
+			newer = readNewer(sequence, frame);
+			break;
+		}
+	}
+
+	waiters.fetch_sub(1, boost::memory_order_seq_cst);
+
+	return newer;
+}
@@ -0,0 +1,57 @@
+/*
+	Newest frame only, for consumers such as control loops that have
+	no use for a backlog.  The publishing thread overwrites the frame
+	under a sequence lock.  Readers copy it without taking a lock,
+	retrying if a write overlaps the copy, so a read costs one frame
+	copy whatever the backlog, plus a retry for each overlapping
+	write.  A reader can also sleep until a frame newer than the one
+	it has arrives.  Frames are counted as they are published, so
+	newer means published later whatever the frame numbers do when the
+	Aurora is reset.
+*/
+
+#include "sensorFrame.h"
+#include "seqLock.h"
+#include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <vector>
+
+#pragma once
+
+class latestFrame
+{
+
+public:
+	latestFrame();
+
+	// Size the frame for numSensors and forget the last one. Only call while nothing is publishing
+	void configure(int numSensors);
+	int getNumSensors() const;
+
+	// Writer side, single thread only
+	void publish(const sensorFrameHeader &header, const sensorRecord *sensors);
+
+	// Copy the newest frame, lock-free but retrying while a write overlaps. Returns false if none has been published since configure
+	bool read(sensorFrame &frame) const;
+
+	// Same, also giving the frame's publish count, which only ever increases
+	bool read(sensorFrame &frame, boost::uint64_t &sequence) const;
+
+	// Block until a frame published after the one numbered sequence, 0 for any, or msTimeout passes. sequence is updated to the frame read
+	bool waitForNewer(boost::uint64_t &sequence, sensorFrame &frame, unsigned int msTimeout);
+
+private:
+	bool readNewer(boost::uint64_t &sequence, sensorFrame &frame) const;
+
+	int numSensors;
+	sensorFrameHeader header;
+	std::vector<sensorRecord> sensors;
+	seqLock lock;
+	boost::uint64_t emptySequence;		// Lock sequence at configure, nothing has been published while it is still there
+
+	// Waiters register so the writer only takes the mutex when someone is asleep
+	boost::atomic<int> waiters;
+	boost::mutex waitMutex;
+	boost::condition_variable waitCondition;
+};
@@ -0,0 +1,175 @@
+#include "logWriter.h"
+#include <cstdarg>
+
+#if defined WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+logWriter::logWriter()
+{
+	file = NULL;
+	syncIntervalMs = DEFAULT_LOG_SYNC_MS;
+	dirty = false;
+	position = 0;
+	openPosition = 0;
+	commits = 0;
+	syncs = 0;
+	errors = 0;
+	longestCommitMs = 0.0;
+	publishStatistics();
+}
+
+logWriter::~logWriter()
+{
+	close();
+}
+
+bool logWriter::open(const std::string &fileName, bool append, bool binary)
+{
+	close();
+
+	if( binary ) file = std::fopen(fileName.c_str(), append ? "ab" : "wb");
+	else file = std::fopen(fileName.c_str(), append ? "a" : "w");
+	if( file == NULL ) return false;
+
+	// Must be set before anything is written
+	buffer.resize(LOG_WRITE_BUFFER_BYTES);
+	std::setvbuf(file, &buffer[0], _IOFBF, buffer.size());
+
+	std::fseek(file, 0, SEEK_END);
+	long end = std::ftell(file);
+	position = end > 0 ? boost::uint64_t( end ) : 0;
+	openPosition = position;
+
+	lastSync = boost::chrono::steady_clock::now();
+	dirty = false;
+	commits = 0;
+	syncs = 0;
+	errors = 0;
+	longestCommitMs = 0.0;
+	publishStatistics();
+
+	return true;
+}
+
+void logWriter::close()
+{
+	if( file == NULL ) return;
+
+	// Everything out and on the disk before the file goes
+	if( std::fflush(file) != 0 ) ++errors;
+	dirty = true;
+	sync();
+
+	std::fclose(file);
+	file = NULL;
+	publishStatistics();
+}
+
+bool logWriter::isOpen() const
+{
+	return file != NULL;
+}
+
+void logWriter::setSyncInterval(unsigned int msInterval)
+{
+	syncIntervalMs = msInterval;
+}
+
+bool logWriter::write(const void *data, size_t bytes)
+{
+	if( file == NULL ) return false;
+
+	if( std::fwrite(data, 1, bytes, file) != bytes )
+	{
+		++errors;
+		return false;
+	}
+
+	position += bytes;
+	return true;
+}
+
+bool logWriter::print(const char *format, ...)
+{
+	if( file == NULL ) return false;
+
+	va_list arguments;
+	va_start(arguments, format);
+	int written = std::vfprintf(file, format, arguments);
+	va_end(arguments);
+
+	if( written < 0 )
+	{
+		++errors;
+		return false;
+	}
+
+	position += written;
+	return true;
+}
+
+bool logWriter::sync()
+{
+	if( file == NULL || !dirty ) return true;
+
+#if defined WIN32
+	bool synced = ( _commit(_fileno(file)) == 0 );
+#else
+	bool synced = ( fsync(fileno(file)) == 0 );
+#endif
+
+	if( synced ) ++syncs;
+	else ++errors;
+
+	lastSync = boost::chrono::steady_clock::now();
+	dirty = false;
+	return synced;
+}
+
+bool logWriter::commit()
+{
+	if( file == NULL ) return false;
+
+	boost::chrono::steady_clock::time_point commitStart = boost::chrono::steady_clock::now();
+
+	// One write for the whole batch
+	bool committed = ( std::fflush(file) == 0 );
+	if( !committed ) ++errors;
+	dirty = true;
+	++commits;
+
+	if( boost::chrono::duration_cast<boost::chrono::milliseconds>(commitStart - lastSync).count() >= syncIntervalMs )
+	{
+		committed = sync() && committed;
+	}
+
+	double ms = boost::chrono::duration<double, boost::milli>(boost::chrono::steady_clock::now() - commitStart).count();
+	if( ms > longestCommitMs ) longestCommitMs = ms;
+
+	publishStatistics();
+	return committed;
+}
+
+boost::uint64_t logWriter::getPosition() const
+{
+	return position;
+}
+
+void logWriter::publishStatistics()
+{
+	boost::lock_guard<boost::mutex> lock(statisticsMutex);
+	counters.bytes = position - openPosition;
+	counters.commits = commits;
+	counters.syncs = syncs;
+	counters.longestCommitMs = longestCommitMs;
+	counters.errors = errors;
+}
+
+void logWriter::getStatistics(logWriterStatistics &statistics) const
+{
+	boost::lock_guard<boost::mutex> lock(statisticsMutex);
+	statistics = counters;
+}
@@ -0,0 +1,77 @@
+/*
+	Buffered writer for the log files.  The file is opened once and
+	written through a large userspace buffer that is only flushed by
+	commit(), so a batch of frames is normally a single write.  The
+	data is also flushed to the disk with fsync, but only once the sync
+	interval has passed since the last one.  That bounds how much a
+	power cut can lose without syncing on every frame.  Only use it
+	from one thread, apart from reading the statistics.
+*/
+
+#include <boost/cstdint.hpp>
+#include <boost/chrono.hpp>
+#include <boost/thread.hpp>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#pragma once
+
+// Log writer constants
+const size_t LOG_WRITE_BUFFER_BYTES = 1024 * 1024;	// Userspace buffer, a second of frames is far less
+const unsigned int DEFAULT_LOG_SYNC_MS = 1000;	// 0 syncs on every commit
+
+// Log writer counters
+typedef struct logWriterStatisticsStruct
+{
+	boost::uint64_t bytes;			// Written since opening
+	unsigned long commits;
+	unsigned long syncs;
+	double longestCommitMs;			// Write and any sync, the time a slow disk holds the logger up
+	unsigned long errors;
+} logWriterStatistics;
+
+class logWriter
+{
+
+public:
+	logWriter();
+	~logWriter();
+
+	// Opens for appending, or emptied first. Text mode keeps the platform's line endings, binary files get positions that match the bytes on disk
+	bool open(const std::string &fileName, bool append = true, bool binary = false);
+	void close();
+	bool isOpen() const;
+
+	void setSyncInterval(unsigned int msInterval);
+
+	// Into the buffer, nothing is written out until the commit
+	bool write(const void *data, size_t bytes);
+	bool print(const char *format, ...);
+
+	// End of a batch, write it out and sync if the interval is up. close() always syncs
+	bool commit();
+
+	boost::uint64_t getPosition() const;
+	void getStatistics(logWriterStatistics &statistics) const;
+
+private:
+	bool sync();
+	void publishStatistics();
+
+	FILE *file;
+	std::vector<char> buffer;
+	unsigned int syncIntervalMs;
+	boost::chrono::steady_clock::time_point lastSync;
+	bool dirty;						// Committed since the last sync
+	boost::uint64_t position;		// Bytes in the file, including what is still buffered
+	boost::uint64_t openPosition;
+	unsigned long commits;
+	unsigned long syncs;
+	unsigned long errors;
+	double longestCommitMs;
+
+	// Copy of the counters as of the last commit, for other threads
+	logWriterStatistics counters;
+	mutable boost::mutex statisticsMutex;
+};
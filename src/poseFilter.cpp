@@ -0,0 +1,275 @@
+#include "poseFilter.h"
+#include "Conversions.h"
+#include <cmath>
+
+// Rate uncertainty a filter starts with
+static const double INITIAL_VELOCITY_NOISE = 500.0;		// mm/s
+static const double INITIAL_ANGULAR_NOISE = 2.0;		// rad/s
+
+// Quaternion product a * b, rotation b then a
+static void quatMultiply(const QuatRotation &a, const QuatRotation &b, QuatRotation &product)
+{
+	product.q0 = a.q0 * b.q0 - a.qx * b.qx - a.qy * b.qy - a.qz * b.qz;
+	product.qx = a.q0 * b.qx + a.qx * b.q0 + a.qy * b.qz - a.qz * b.qy;
+	product.qy = a.q0 * b.qy - a.qx * b.qz + a.qy * b.q0 + a.qz * b.qx;
+	product.qz = a.q0 * b.qz + a.qx * b.qy - a.qy * b.qx + a.qz * b.q0;
+}
+
+// Rotation by |v| radians about v
+static void quatFromRotationVector(const double v[3], QuatRotation &rotation)
+{
+	double angle = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+	double scale = angle > 1.0e-9 ? std::sin(angle / 2.0) / angle : 0.5;
+
+	rotation.q0 = float(std::cos(angle / 2.0));
+	rotation.qx = float(v[0] * scale);
+	rotation.qy = float(v[1] * scale);
+	rotation.qz = float(v[2] * scale);
+}
+
+// Inverse of quatFromRotationVector, taking the shorter way round
+static void quatToRotationVector(const QuatRotation &rotation, double v[3])
+{
+	double sign = rotation.q0 < 0.0f ? -1.0 : 1.0;
+	double length = std::sqrt((double)rotation.qx * rotation.qx + (double)rotation.qy * rotation.qy + (double)rotation.qz * rotation.qz);
+	double angle = 2.0 * std::atan2(length, sign * rotation.q0);
+	double scale = length > 1.0e-9 ? sign * angle / length : 2.0 * sign;
+
+	v[0] = rotation.qx * scale;
+	v[1] = rotation.qy * scale;
+	v[2] = rotation.qz * scale;
+}
+
+void defaultPoseFilterSettings(poseFilterSettings &settings)
+{
+	settings.positionProcessNoise = 1000.0;
+	settings.rotationProcessNoise = 10.0;
+	settings.positionMeasurementNoise = 0.5;
+	settings.rotationMeasurementNoise = 0.005;
+	settings.maxPredictionMs = 100.0;
+}
+
+poseFilter::poseFilter()
+{
+	defaultPoseFilterSettings(settings);
+	reset();
+}
+
+void poseFilter::setSettings(const poseFilterSettings &settings)
+{
+	this->settings = settings;
+	reset();
+}
+
+void poseFilter::reset()
+{
+	lock.reset();
+	numSensors = 0;
+
+	for( int i = 0; i != MAX_NUM_OF_SENSORS; ++i )
+	{
+		states[i].initialized = false;
+		published[i].valid = false;
+	}
+}
+
+void poseFilter::initialize(sensorState &state, const sensorRecord &sensor, boost::int64_t time)
+{
+	const float *position = &sensor.translation.x;
+	double positionVariance = settings.positionMeasurementNoise * settings.positionMeasurementNoise;
+	double rotationVariance = settings.rotationMeasurementNoise * settings.rotationMeasurementNoise;
+
+	for( int axis = 0; axis != 3; ++axis )
+	{
+		axisState &p = state.position[axis];
+		p.value = position[axis];
+		p.rate = 0.0;
+		p.p00 = positionVariance;
+		p.p01 = 0.0;
+		p.p11 = INITIAL_VELOCITY_NOISE * INITIAL_VELOCITY_NOISE;
+
+		axisState &r = state.rotation[axis];
+		r.value = 0.0;
+		r.rate = 0.0;
+		r.p00 = rotationVariance;
+		r.p01 = 0.0;
+		r.p11 = INITIAL_ANGULAR_NOISE * INITIAL_ANGULAR_NOISE;
+	}
+
+	state.orientation = sensor.rotation;
+	QuatNormalize(&state.orientation);
+	state.time = time;
+	state.initialized = true;
+}
+
+void poseFilter::predictAxis(axisState &axis, double dt, double noise)
+{
+	// Constant velocity with white noise acceleration of the given standard deviation
+	double q = noise * noise;
+	double dt2 = dt * dt;
+
+	axis.value += axis.rate * dt;
+
+	axis.p00 += dt * ( 2.0 * axis.p01 + dt * axis.p11 ) + q * dt2 * dt / 3.0;
+	axis.p01 += dt * axis.p11 + q * dt2 / 2.0;
+	axis.p11 += q * dt;
+}
+
+void poseFilter::updateAxis(axisState &axis, double measurement, double variance)
+{
+	double innovation = measurement - axis.value;
+	double s = axis.p00 + variance;
+	double k0 = axis.p00 / s;
+	double k1 = axis.p01 / s;
+
+	axis.value += k0 * innovation;
+	axis.rate += k1 * innovation;
+
+	// (I - KH)P, in the order that keeps using the old terms
+	axis.p11 -= k1 * axis.p01;
+	axis.p01 -= k1 * axis.p00;
+	axis.p00 -= k0 * axis.p00;
+}
+
+void poseFilter::extrapolate(const filteredPose &from, double dt, sensorPose &to)
+{
+	to.translation.x = float(from.estimate.translation.x + from.velocity.x * dt);
+	to.translation.y = float(from.estimate.translation.y + from.velocity.y * dt);
+	to.translation.z = float(from.estimate.translation.z + from.velocity.z * dt);
+
+	double turn[3] = { from.angularVelocity.x * dt, from.angularVelocity.y * dt, from.angularVelocity.z * dt };
+	QuatRotation step;
+	quatFromRotationVector(turn, step);
+	quatMultiply(step, from.estimate.rotation, to.rotation);
+	QuatNormalize(&to.rotation);
+
+	to.status = from.estimate.status;
+	if( dt > 0.0 ) to.status |= SENSOR_EXTRAPOLATED;
+}
+
+void poseFilter::addFrame(const sensorFrameHeader &header, const sensorRecord *sensors, boost::int64_t deliveryTime)
+{
+	int slots = header.numSensors < MAX_NUM_OF_SENSORS ? header.numSensors : MAX_NUM_OF_SENSORS;
+	double positionVariance = settings.positionMeasurementNoise * settings.positionMeasurementNoise;
+	double rotationVariance = settings.rotationMeasurementNoise * settings.rotationMeasurementNoise;
+	double latency = ( deliveryTime - header.acquisitionTime ) / 1.0e9;
+	if( latency < 0.0 ) latency = 0.0;
+	if( latency > settings.maxPredictionMs / 1000.0 ) latency = settings.maxPredictionMs / 1000.0;
+
+	lock.writeBegin();
+	numSensors = slots;
+
+	for( int i = 0; i != slots; ++i )
+	{
+		sensorState &state = states[i];
+		const sensorRecord &sensor = sensors[i];
+		filteredPose &output = published[i];
+
+		// No measurement, keep the last output until it is too old to carry on from
+		if( ( sensor.status & SENSOR_NO_POSE_BITS ) || sensor.translation.x < MAX_NEGATIVE )
+		{
+			if( state.initialized && ( header.acquisitionTime - state.time ) / 1.0e6 > MAX_FILTER_GAP_MS )
+			{
+				state.initialized = false;
+				output.valid = false;
+			}
+			continue;
+		}
+
+		double dt = ( header.acquisitionTime - state.time ) / 1.0e9;
+
+		if( !state.initialized || dt <= 0.0 || dt * 1000.0 > MAX_FILTER_GAP_MS )
+		{
+			initialize(state, sensor, header.acquisitionTime);
+		}
+		else
+		{
+			const float *position = &sensor.translation.x;
+			double turn[3];
+			QuatRotation step, predicted, inverse, residual;
+
+			// Predict to this frame
+			for( int axis = 0; axis != 3; ++axis )
+			{
+				predictAxis(state.position[axis], dt, settings.positionProcessNoise);
+				predictAxis(state.rotation[axis], dt, settings.rotationProcessNoise);
+				turn[axis] = state.rotation[axis].value;
+				state.rotation[axis].value = 0.0;
+			}
+			quatFromRotationVector(turn, step);
+			quatMultiply(step, state.orientation, predicted);
+
+			// Rotation from the predicted to the measured orientation
+			inverse.q0 = predicted.q0;
+			inverse.qx = -predicted.qx;
+			inverse.qy = -predicted.qy;
+			inverse.qz = -predicted.qz;
+			quatMultiply(sensor.rotation, inverse, residual);
+			quatToRotationVector(residual, turn);
+
+			// Correct
+			for( int axis = 0; axis != 3; ++axis )
+			{
+				updateAxis(state.position[axis], position[axis], positionVariance);
+				updateAxis(state.rotation[axis], turn[axis], rotationVariance);
+				turn[axis] = state.rotation[axis].value;
+				state.rotation[axis].value = 0.0;
+			}
+			quatFromRotationVector(turn, step);
+			quatMultiply(step, predicted, state.orientation);
+			QuatNormalize(&state.orientation);
+
+			state.time = header.acquisitionTime;
+		}
+
+		// Publish the estimate, and the prediction to delivery
+		output.valid = true;
+		output.estimate.translation.x = float(state.position[0].value);
+		output.estimate.translation.y = float(state.position[1].value);
+		output.estimate.translation.z = float(state.position[2].value);
+		output.estimate.rotation = state.orientation;
+		output.estimate.status = sensor.status;
+		output.velocity.x = float(state.position[0].rate);
+		output.velocity.y = float(state.position[1].rate);
+		output.velocity.z = float(state.position[2].rate);
+		output.angularVelocity.x = float(state.rotation[0].rate);
+		output.angularVelocity.y = float(state.rotation[1].rate);
+		output.angularVelocity.z = float(state.rotation[2].rate);
+		output.estimateTime = state.time;
+		output.latencyMs = latency * 1000.0;
+		extrapolate(output, latency, output.prediction);
+	}
+
+	lock.writeEnd();
+}
+
+bool poseFilter::getFilteredPose(int slot, filteredPose &pose) const
+{
+	boost::uint64_t begin;
+	bool valid;
+
+	do
+	{
+		begin = lock.readBegin();
+		valid = slot >= 0 && slot < numSensors && published[slot].valid;
+		if( valid ) pose = published[slot];
+	}
+	while( lock.readRetry(begin) );
+
+	return valid;
+}
+
+bool poseFilter::predictPose(int slot, boost::int64_t time, sensorPose &pose) const
+{
+	filteredPose latest;
+
+	if( !getFilteredPose(slot, latest) ) return false;
+
+	double ahead = ( time - latest.estimateTime ) / 1.0e9;
+
+	// Only forwards, and not far
+	if( ahead < 0.0 || ahead * 1000.0 > settings.maxPredictionMs ) return false;
+
+	extrapolate(latest, ahead, pose);
+	return true;
+}
@@ -0,0 +1,93 @@
+/*
+	Optional constant velocity Kalman filter on each sensor.  Every
+	axis of the position is filtered as a position and velocity pair,
+	and the orientation the same way on the small rotation between
+	the predicted and measured orientation, so each frame costs a
+	fixed amount of arithmetic and nothing is allocated.  For each
+	frame the smoothed pose at the acquisition time is published with
+	a prediction to the time the frame was delivered, and the state
+	can be predicted to any other time shortly after.
+*/
+
+#include "sensorFrame.h"
+#include "poseInterpolator.h"
+#include "seqLock.h"
+#include <boost/cstdint.hpp>
+
+#pragma once
+
+// Filter constants
+const double MAX_FILTER_GAP_MS = 200.0;		// A sensor missing for longer than this starts its filter again
+
+// Tuning of the filter, the noise figures are standard deviations
+typedef struct poseFilterSettingsStruct
+{
+	double positionProcessNoise;		// Unmodelled acceleration, mm/s^2
+	double rotationProcessNoise;		// Unmodelled angular acceleration, rad/s^2
+	double positionMeasurementNoise;	// mm
+	double rotationMeasurementNoise;	// rad
+	double maxPredictionMs;				// Furthest ahead of a frame a pose is predicted
+} poseFilterSettings;
+
+// Filter output for one sensor
+typedef struct filteredPoseStruct
+{
+	bool valid;
+	sensorPose estimate;			// Smoothed pose at the frame's acquisition time
+	sensorPose prediction;			// Predicted to when the frame was delivered
+	Position3d velocity;			// mm/s
+	Position3d angularVelocity;		// rad/s, about the tracker axes
+	boost::int64_t estimateTime;	// Acquisition time of the frame, steady clock nanoseconds
+	double latencyMs;				// From acquisition to delivery of the frame
+} filteredPose;
+
+// Settings that suit hand held tools
+void defaultPoseFilterSettings(poseFilterSettings &settings);
+
+class poseFilter
+{
+
+public:
+	poseFilter();
+
+	// Only call while nothing is adding frames
+	void setSettings(const poseFilterSettings &settings);
+	void reset();
+
+	// Post-processing stage only, one frame at a time in frame order. deliveryTime is when the frame is handed on, steady clock nanoseconds
+	void addFrame(const sensorFrameHeader &header, const sensorRecord *sensors, boost::int64_t deliveryTime);
+
+	// Any thread
+	bool getFilteredPose(int slot, filteredPose &pose) const;
+	bool predictPose(int slot, boost::int64_t time, sensorPose &pose) const;
+
+private:
+	// One axis, a value and its rate with their covariance
+	typedef struct axisStateStruct
+	{
+		double value;
+		double rate;
+		double p00, p01, p11;
+	} axisState;
+
+	typedef struct sensorStateStruct
+	{
+		bool initialized;
+		boost::int64_t time;
+		axisState position[3];
+		axisState rotation[3];		// Values are the correction to orientation, zero between frames
+		QuatRotation orientation;
+	} sensorState;
+
+	void initialize(sensorState &state, const sensorRecord &sensor, boost::int64_t time);
+	static void predictAxis(axisState &axis, double dt, double noise);
+	static void updateAxis(axisState &axis, double measurement, double variance);
+	static void extrapolate(const filteredPose &from, double dt, sensorPose &to);
+
+	poseFilterSettings settings;
+	sensorState states[MAX_NUM_OF_SENSORS];		// Only the stage adding frames
+
+	int numSensors;
+	filteredPose published[MAX_NUM_OF_SENSORS];
+	seqLock lock;
+};
@@ -0,0 +1,134 @@
+#include "poseInterpolator.h"
+#include "Conversions.h"
+
+poseInterpolator::poseInterpolator()
+{
+	reset();
+}
+
+void poseInterpolator::reset()
+{
+	lock.reset();
+	numSensors = 0;
+	newest = POSE_HISTORY_SIZE - 1;
+	count = 0;
+}
+
+void poseInterpolator::addFrame(const sensorFrameHeader &header, const sensorRecord *sensors)
+{
+	int next = ( newest + 1 ) % POSE_HISTORY_SIZE;
+	int slots = header.numSensors < MAX_NUM_OF_SENSORS ? header.numSensors : MAX_NUM_OF_SENSORS;
+
+	lock.writeBegin();
+
+	frameTimes[next] = header.acquisitionTime;
+	for( int i = 0; i != slots; ++i )
+	{
+		samples[next][i].rotation = sensors[i].rotation;
+		samples[next][i].translation = sensors[i].translation;
+		samples[next][i].status = sensors[i].status;
+
+		// Poses the Aurora marked as bad don't count either
+		if( sensors[i].translation.x < MAX_NEGATIVE ) samples[next][i].status |= SENSOR_TRANSFORM_MISSING;
+	}
+
+	numSensors = slots;
+	newest = next;
+	if( count < POSE_HISTORY_SIZE ) ++count;
+
+	lock.writeEnd();
+}
+
+bool poseInterpolator::findSamples(int slot, boost::int64_t time, poseSample &before, boost::int64_t &beforeTime,
+	poseSample &after, boost::int64_t &afterTime) const
+{
+	bool haveBefore = false;
+	bool haveAfter = false;
+	bool havePrevious = false;
+	poseSample previous;
+	boost::int64_t previousTime = 0;
+
+	if( slot < 0 || slot >= numSensors ) return false;
+
+	// Newest first, keeping the oldest usable sample after the time and the newest at or before it
+	for( int n = 0; n != count; ++n )
+	{
+		int index = ( newest - n + POSE_HISTORY_SIZE ) % POSE_HISTORY_SIZE;
+		const poseSample &sample = samples[index][slot];
+
+		if( sample.status & SENSOR_NO_POSE_BITS ) continue;
+
+		if( frameTimes[index] > time )
+		{
+			after = sample;
+			afterTime = frameTimes[index];
+			haveAfter = true;
+			continue;
+		}
+
+		// The first usable sample at or before the time
+		if( !haveBefore )
+		{
+			before = sample;
+			beforeTime = frameTimes[index];
+			haveBefore = true;
+
+			if( haveAfter ) return true;
+			continue;
+		}
+
+		// Past the newest frame, the sample before that is needed to extrapolate
+		previous = sample;
+		previousTime = frameTimes[index];
+		havePrevious = true;
+		break;
+	}
+
+	if( !haveBefore ) return false;
+
+	// Extrapolating, before is the newest sample and previous the one ahead of it
+	if( !havePrevious ) return false;
+
+	after = before;
+	afterTime = beforeTime;
+	before = previous;
+	beforeTime = previousTime;
+	return true;
+}
+
+bool poseInterpolator::getPose(int slot, boost::int64_t time, sensorPose &pose) const
+{
+	poseSample before, after;
+	boost::int64_t beforeTime = 0, afterTime = 0;
+	bool found;
+	boost::uint64_t begin;
+
+	// Copy the two samples out, the arithmetic happens outside the lock
+	do
+	{
+		begin = lock.readBegin();
+		found = findSamples(slot, time, before, beforeTime, after, afterTime);
+	}
+	while( lock.readRetry(begin) );
+
+	if( !found ) return false;
+
+	double gapMs = ( afterTime - beforeTime ) / 1.0e6;
+	double pastMs = ( time - afterTime ) / 1.0e6;
+
+	// Too far apart to trust a straight line, or too far past the newest frame
+	if( gapMs <= 0.0 || gapMs > MAX_INTERPOLATION_GAP_MS ) return false;
+	if( pastMs > MAX_EXTRAPOLATION_MS ) return false;
+
+	double t = ( time - beforeTime ) / 1.0e6 / gapMs;
+
+	pose.translation.x = float(before.translation.x + t * ( after.translation.x - before.translation.x ));
+	pose.translation.y = float(before.translation.y + t * ( after.translation.y - before.translation.y ));
+	pose.translation.z = float(before.translation.z + t * ( after.translation.z - before.translation.z ));
+	QuatSlerp(&before.rotation, &after.rotation, t, &pose.rotation);
+
+	pose.status = t < 0.5 ? before.status : after.status;
+	if( pastMs > 0.0 ) pose.status |= SENSOR_EXTRAPOLATED;
+
+	return true;
+}
@@ -0,0 +1,63 @@
+/*
+	Sensor poses at any time, not just at the Aurora's frame times.
+	Post-processing keeps the last few frames of every slot under
+	a sequence lock, and a query finds the two frames either side of
+	the requested time and interpolates between them: linearly for
+	the position and by SLERP for the orientation.  Times a little
+	past the newest frame are extrapolated from the last two frames,
+	further than that, before the history or across a long gap in a
+	sensor's data there is no pose.
+*/
+
+#include "sensorFrame.h"
+#include "seqLock.h"
+#include <boost/cstdint.hpp>
+
+#pragma once
+
+// Interpolation constants
+const int POSE_HISTORY_SIZE = 32;					// Frames kept, about 0.8 s at 40 Hz
+const double MAX_INTERPOLATION_GAP_MS = 150.0;		// Frames further apart than this aren't interpolated between
+const double MAX_EXTRAPOLATION_MS = 50.0;			// Furthest past the newest frame a pose is extrapolated
+
+// Pose of one sensor at a queried time
+typedef struct sensorPoseStruct
+{
+	QuatRotation rotation;
+	Position3d translation;
+	unsigned int status;		// SENSOR_ bits of the nearer frame, SENSOR_EXTRAPOLATED if past the newest
+} sensorPose;
+
+class poseInterpolator
+{
+
+public:
+	poseInterpolator();
+
+	// Forget the history. Only call while nothing is adding frames
+	void reset();
+
+	// Post-processing stage only, one frame at a time in time order
+	void addFrame(const sensorFrameHeader &header, const sensorRecord *sensors);
+
+	// Any thread, time is on the steady clock in nanoseconds like acquisitionTime. Returns false if there is no pose
+	bool getPose(int slot, boost::int64_t time, sensorPose &pose) const;
+
+private:
+	typedef struct poseSampleStruct
+	{
+		QuatRotation rotation;
+		Position3d translation;
+		unsigned int status;
+	} poseSample;
+
+	bool findSamples(int slot, boost::int64_t time, poseSample &before, boost::int64_t &beforeTime,
+		poseSample &after, boost::int64_t &afterTime) const;
+
+	boost::int64_t frameTimes[POSE_HISTORY_SIZE];
+	poseSample samples[POSE_HISTORY_SIZE][MAX_NUM_OF_SENSORS];
+	int numSensors;
+	int newest;
+	int count;
+	seqLock lock;
+};
@@ -0,0 +1,88 @@
+/*
+	Frame types passed from the tracking thread to the consumers.  A
+	frame is a small header followed by one record per sensor slot,
+	and the number of slots is fixed when the sensors are activated,
+	so frames are only as big as the sensors actually in use.
+*/
+
+#include "APIStructures.h"
+#include <boost/static_assert.hpp>
+#include <boost/cstdint.hpp>
+#include <vector>
+
+#pragma once
+
+// Most sensors a frame can carry, the number actually used is set at activation
+const int MAX_NUM_OF_SENSORS = 16;
+
+// Sensor status bits, the low 16 bits are the port handle status word from the BX reply
+const unsigned int SENSOR_TOOL_IN_PORT			= 0x00000001;
+const unsigned int SENSOR_INITIALIZED			= 0x00000010;
+const unsigned int SENSOR_ENABLED				= 0x00000020;
+const unsigned int SENSOR_OUT_OF_VOLUME			= 0x00000040;
+const unsigned int SENSOR_PARTIALLY_OUT_OF_VOLUME	= 0x00000080;
+const unsigned int SENSOR_BROKEN				= 0x00000100;
+const unsigned int SENSOR_DISTURBANCE			= 0x00000200;
+const unsigned int SENSOR_SIGNAL_TOO_SMALL		= 0x00000400;
+const unsigned int SENSOR_SIGNAL_TOO_BIG		= 0x00000800;
+const unsigned int SENSOR_PROCESSING_EXCEPTION	= 0x00001000;
+const unsigned int SENSOR_HARDWARE_FAILURE		= 0x00002000;
+
+// The upper bits say why there is no pose
+const unsigned int SENSOR_TRANSFORM_MISSING		= 0x00010000;	// Tool reported but not seen
+const unsigned int SENSOR_TRANSFORM_DISABLED	= 0x00020000;
+const unsigned int SENSOR_SLOT_EMPTY			= 0x00040000;	// Vacant slot, or the handle wasn't in this reply
+const unsigned int SENSOR_EXTRAPOLATED			= 0x00080000;	// Pose predicted past the newest frame
+
+// Any of these means the record has no pose
+const unsigned int SENSOR_NO_POSE_BITS = SENSOR_TRANSFORM_MISSING | SENSOR_TRANSFORM_DISABLED | SENSOR_SLOT_EMPTY;
+
+// Data for one sensor in a frame, 40 bytes with no padding so frames copy as one block
+typedef struct sensorRecordStruct
+{
+	QuatRotation rotation;
+	Position3d translation;
+	float error;				// RMS error of the measurement, BAD_FLOAT if there is no pose
+	unsigned int status;		// SENSOR_ bits
+	unsigned int frameNumber;	// Device frame the measurement came from
+} sensorRecord;
+
+BOOST_STATIC_ASSERT(sizeof(sensorRecord) == 40);
+
+// Front of every frame
+typedef struct sensorFrameHeaderStruct
+{
+	unsigned long frameNumber;
+	unsigned int systemStatus;	// System status word from the BX reply
+	int numSensors;
+	boost::int64_t acquisitionTime;	// Estimated host steady clock time the frame was measured, nanoseconds since the clock's epoch
+} sensorFrameHeader;
+
+// Read only view of a frame stored elsewhere, nothing is copied
+typedef struct sensorFrameViewStruct
+{
+	const sensorFrameHeader *header;
+	const sensorRecord *sensors;	// header->numSensors records
+} sensorFrameView;
+
+// A frame with its own storage. Sized once, so reusing one doesn't allocate
+class sensorFrame
+{
+
+public:
+	sensorFrame() { header.frameNumber = 0; header.numSensors = 0; }
+	explicit sensorFrame(int numSensors) { header.frameNumber = 0; resize(numSensors); }
+
+	// Only allocates when growing past anything it has held before
+	void resize(int numSensors) { header.numSensors = numSensors; sensors.resize(numSensors); }
+	int getNumSensors() const { return header.numSensors; }
+
+	sensorFrameView view() const
+	{
+		sensorFrameView frameView = { &header, sensors.empty() ? NULL : &sensors[0] };
+		return frameView;
+	}
+
+	sensorFrameHeader header;
+	std::vector<sensorRecord> sensors;
+};
@@ -0,0 +1,106 @@
+#include "sensorHealth.h"
+#include <boost/chrono.hpp>
+
+sensorHealth::sensorHealth()
+{
+	waiters = 0;
+	reset();
+}
+
+void sensorHealth::reset()
+{
+	sensorStatusEvent discarded;
+
+	for( int i = 0; i != MAX_NUM_OF_SENSORS; ++i )
+	{
+		slotStatus[i] = SENSOR_SLOT_EMPTY;
+	}
+
+	brokenSlots = 0;
+	droppedEvents = 0;
+
+	while( events.pop(discarded) )
+	{
+	}
+}
+
+void sensorHealth::update(int slot, unsigned int status, unsigned long frameNumber)
+{
+	unsigned int previousStatus = slotStatus[slot].load(boost::memory_order_relaxed);
+
+	// Nothing to publish most frames
+	if( status == previousStatus ) return;
+
+	slotStatus[slot].store(status, boost::memory_order_release);
+
+	// Only one stage writes the mask, a frame at a time, so a plain store of the new value is enough
+	unsigned int broken = brokenSlots.load(boost::memory_order_relaxed);
+	if( status & SENSOR_BROKEN ) broken |= 1u << slot;
+	else broken &= ~( 1u << slot );
+	brokenSlots.store(broken, boost::memory_order_release);
+
+	sensorStatusEvent event;
+	event.frameNumber = frameNumber;
+	event.slot = slot;
+	event.previousStatus = previousStatus;
+	event.status = status;
+
+	if( !events.push(event) )
+	{
+		droppedEvents.fetch_add(1, boost::memory_order_relaxed);
+		return;
+	}
+
+	// Wake the consumer if it is asleep, the fence pairs with the count in waitForEvent
+	boost::atomic_thread_fence(boost::memory_order_seq_cst);
+	if( waiters.load(boost::memory_order_seq_cst) > 0 )
+	{
+		boost::lock_guard<boost::mutex> guard(waitMutex);
+		waitCondition.notify_all();
+	}
+}
+
+unsigned int sensorHealth::getStatus(int slot) const
+{
+	return slotStatus[slot].load(boost::memory_order_acquire);
+}
+
+unsigned int sensorHealth::getBrokenSlots() const
+{
+	return brokenSlots.load(boost::memory_order_acquire);
+}
+
+unsigned long sensorHealth::getDroppedEvents() const
+{
+	return droppedEvents.load(boost::memory_order_relaxed);
+}
+
+bool sensorHealth::popEvent(sensorStatusEvent &event)
+{
+	return events.pop(event);
+}
+
+bool sensorHealth::waitForEvent(sensorStatusEvent &event, unsigned int msTimeout)
+{
+	if( events.pop(event) ) return true;
+
+	boost::chrono::steady_clock::time_point deadline = boost::chrono::steady_clock::now() + boost::chrono::milliseconds(msTimeout);
+	boost::unique_lock<boost::mutex> guard(waitMutex);
+	bool popped = false;
+
+	// Count ourselves before checking again so an event queued in between can't be missed
+	waiters.fetch_add(1, boost::memory_order_seq_cst);
+
+	while( !( popped = events.pop(event) ) )
+	{
+		if( waitCondition.wait_until(guard, deadline) == boost::cv_status::timeout )
+		{
+			popped = events.pop(event);
+			break;
+		}
+	}
+
+	waiters.fetch_sub(1, boost::memory_order_seq_cst);
+
+	return popped;
+}
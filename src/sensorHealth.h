@@ -0,0 +1,66 @@
+/*
+	Health of each sensor slot.  The publishing stage publishes each
+	slot's status bits with an atomic store and, when they change,
+	queues an event with the frame it happened on.  Readers get the
+	current bits without a lock, and a consumer can take the
+	transitions from the queue, or sleep until one arrives, rather
+	than polling the status.  The publishing stage only touches a
+	mutex when it queues an event for a consumer that is asleep.
+*/
+
+#include "sensorFrame.h"
+#include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+#include <boost/array.hpp>
+#include <boost/lockfree/spsc_queue.hpp>
+
+#pragma once
+
+// Status transitions held for the consumer, later ones are dropped and counted if it falls this far behind
+const int STATUS_EVENT_QUEUE_SIZE = 256;
+
+// Status bits that make a sensor's data unusable
+const unsigned int SENSOR_INVALID_BITS = SENSOR_BROKEN | SENSOR_SLOT_EMPTY;
+
+// A change in a slot's status bits
+typedef struct sensorStatusEventStruct
+{
+	unsigned long frameNumber;		// Frame the new status was first seen in
+	int slot;
+	unsigned int previousStatus;	// SENSOR_ bits
+	unsigned int status;
+} sensorStatusEvent;
+
+class sensorHealth
+{
+
+public:
+	sensorHealth();
+
+	// Mark every slot empty and clear the events. Only call while nothing is updating
+	void reset();
+
+	// Post-processing stage only, one frame at a time in frame order
+	void update(int slot, unsigned int status, unsigned long frameNumber);
+
+	// Any thread
+	unsigned int getStatus(int slot) const;
+	unsigned int getBrokenSlots() const;	// Bit n set if slot n is broken now
+	unsigned long getDroppedEvents() const;
+
+	// Single consumer. The wait returns false if no event arrives within msTimeout
+	bool popEvent(sensorStatusEvent &event);
+	bool waitForEvent(sensorStatusEvent &event, unsigned int msTimeout);
+
+private:
+	boost::array<boost::atomic<unsigned int>, MAX_NUM_OF_SENSORS> slotStatus;
+	boost::atomic<unsigned int> brokenSlots;
+
+	boost::lockfree::spsc_queue< sensorStatusEvent, boost::lockfree::capacity<STATUS_EVENT_QUEUE_SIZE> > events;
+	boost::atomic<unsigned long> droppedEvents;
+
+	// The consumer registers before sleeping so the publishing stage only takes the mutex when it has to
+	boost::atomic<int> waiters;
+	boost::mutex waitMutex;
+	boost::condition_variable waitCondition;
+};
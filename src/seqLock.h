@@ -0,0 +1,69 @@
+/*
+	Sequence lock for data with a single writer and any number of
+	readers.  The writer makes the sequence odd while it writes and
+	even again when it is done.  Readers never block the writer:
+	they copy the data and retry if the sequence changed or was odd.
+	Reading is lock-free but not wait-free, a reader spins while a
+	write is in progress and retries after every write it overlaps.
+*/
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+
+#pragma once
+
+class seqLock
+{
+
+public:
+	seqLock()
+	{
+		sequence = 0;
+	}
+
+	// Back to no writes, only while nothing is reading or writing
+	void reset()
+	{
+		sequence = 0;
+	}
+
+	// Writer side, single thread only
+	void writeBegin()
+	{
+		sequence.store(sequence.load(boost::memory_order_relaxed) + 1, boost::memory_order_relaxed);
+		boost::atomic_thread_fence(boost::memory_order_release);
+	}
+
+	void writeEnd()
+	{
+		sequence.store(sequence.load(boost::memory_order_relaxed) + 1, boost::memory_order_seq_cst);
+	}
+
+	// Reader side, copy the data between these and retry while readRetry returns true
+	boost::uint64_t readBegin() const
+	{
+		boost::uint64_t begin;
+
+		while( ( begin = sequence.load(boost::memory_order_acquire) ) & 1 )
+		{
+			// Write in progress
+		}
+
+		return begin;
+	}
+
+	bool readRetry(boost::uint64_t begin) const
+	{
+		boost::atomic_thread_fence(boost::memory_order_acquire);
+		return sequence.load(boost::memory_order_relaxed) != begin;
+	}
+
+	// Number of completed writes
+	boost::uint64_t getWrites() const
+	{
+		return sequence.load(boost::memory_order_seq_cst) / 2;
+	}
+
+private:
+	boost::atomic<boost::uint64_t> sequence;
+};
@@ -4,6 +4,8 @@
 
 #if defined WIN32
 #include <WinBase.h>
+#else
+#include <termios.h>
 #endif
 
 serialCommunicator::serialCommunicator()
@@ -116,14 +118,15 @@ int serialCommunicator::SerialBreak()
 
 int serialCommunicator::SerialFlush()
 {
-	//// Check to see if port is working correctly
-	//if( serial->error() ) return -1;
+	if( !newSerial->is_open() ) return 0;
 
-	//// Flush input buffer
-	//if( serial->flush() ) return 1;
-	//else return -1;
+	// Asio has no flush, discard anything still in the driver buffers so the next reply starts clean
+#if defined WIN32
+	if( !PurgeComm(newSerial->native_handle(), PURGE_RXCLEAR | PURGE_TXCLEAR) ) return 0;
+#else
+	if( tcflush(newSerial->native_handle(), TCIOFLUSH) != 0 ) return 0;
+#endif
 
-	// Using the asio library this function should not be needed
 	return 1;
 }
 
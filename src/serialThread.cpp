@@ -1,15 +1,70 @@
 #include "serialThread.h"
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <boost/bind.hpp>
 
-serialThread::serialThread()
+serialThread::serialThread() : SessionLog(LogFile), FrameBuffer(BUFFER_SIZE), ControllerSpill(BUFFER_SIZE), FrameDispatcher(FrameBuffer), PostProcessing(PIPELINE_DEPTH)
 {
 	// Set class variables
-	brokenSensors = false;
 	stopTrackingFlag = false;
 	stopLoggingFlag = false;
+	stopDispatcherFlag = false;
 	numSensors = 0;
+	spareSensorSlots = DEFAULT_SPARE_SENSOR_SLOTS;
 	currentFrameNumber = 0;
+	trackingSuspended = false;
+	deferSensorMetadata = false;
+	sensorMetadataChanges = 0;
+	poseFiltering = false;
+	historySubscription = -1;
+	controllerSpilling = false;
+	postProcessingThreads = DEFAULT_PIPELINE_THREADS;
+	logSyncIntervalMs = DEFAULT_LOG_SYNC_MS;
+	logFileFormat = LOG_FORMAT_TEXT;
+	sensorSlotHandles.fill(-1);
+	loggingSubscriber = FrameBuffer.subscribe();
+	controllerSubscriber = FrameBuffer.subscribe();
+	for( int i = 0; i != MAX_NUM_OF_SENSORS; ++i )
+	{
+		sensorsMetadata[i].ready = false;
+		sensorsMetadata[i].handle = -1;
+	}
+
+	// Work done on each frame after it is read, in this order
+	PostProcessing.addStage(boost::bind(&serialThread::publishFrame, this, _1));
+	PostProcessing.addStage(boost::bind(&serialThread::spillFrame, this, _1));
+	PostProcessing.addStage(boost::bind(&serialThread::trackPoses, this, _1));
+	PostProcessing.addStage(boost::bind(&serialThread::updateStatistics, this, _1));
+	PostProcessing.addStage(boost::bind(&serialThread::deliverFrame, this, _1));
+
+	// Threads run with the OS defaults unless asked otherwise
+	defaultThreadPolicy(requestedThreadPolicy);
+	currentThreadPolicy.trackingScheduling = false;
+	currentThreadPolicy.trackingAffinity = false;
+	currentThreadPolicy.loggingScheduling = false;
+	currentThreadPolicy.loggingAffinity = false;
+	currentThreadPolicy.memoryLocked = false;
+
+	phaseLockedScheduling = true;
+
+	// Link recovery
+	comHardwareHandshake = false;
+	linkTimeoutMs = DEFAULT_LINK_TIMEOUT;
+	consecutiveLinkFailures = 0;
+	resetBackoffMs = 0;
+	sessionSavePending = false;
+	currentLinkMetrics.state = LINK_OK;
+	currentLinkMetrics.outages = 0;
+	currentLinkMetrics.resyncs = 0;
+	currentLinkMetrics.reinits = 0;
+	currentLinkMetrics.resets = 0;
+	currentLinkMetrics.lastOutageMs = 0;
+	currentLinkMetrics.longestOutageMs = 0;
+	currentLinkMetrics.totalOutageMs = 0;
 
 	// Give a COM port to the command handling class
 	SerialCommands.setCOMPort(SerialPort);
@@ -17,30 +72,59 @@ serialThread::serialThread()
 
 serialThread::~serialThread()
 {
-	stopTracking();	// Make sure everything has stopped when we exit
+	// Make sure everything has stopped when we exit, unless the session was handed over to another process
+	if( !trackingSuspended ) stopTracking();
 }
 
 void serialThread::runTracking()
 {	
-		for(;;)
+		// Real-time priority and CPU pinning, if requested
+		applyThreadPolicy(requestedThreadPolicy.trackingScheduling, requestedThreadPolicy.trackingPriority, requestedThreadPolicy.trackingCpu,
+			currentThreadPolicy.trackingScheduling, currentThreadPolicy.trackingAffinity);
+
+		// No fixed sleeps, the loop is paced by the frame schedule and by blocking on the BX reply
+		while( !stopTrackingFlag.load(boost::memory_order_acquire) )
 		{
-			// Create an interruption period
-			boost::this_thread::sleep_for(boost::chrono::milliseconds(1));
-			
-			// Check to see if we need to stop the thread
-			stopTrackMutex.lock();
-			if( stopTrackingFlag ) break;
-			stopTrackMutex.unlock();
-
-			// Get sensor data
-			if( SerialCommands.nGetBXTransforms(false) == 1 )
+			// Hold off until the Aurora should have a new frame
+			if( phaseLockedScheduling ) waitForNextRequest();
+			if( stopTrackingFlag.load(boost::memory_order_acquire) ) break;
+
+			schedulerTime requestTime = boost::chrono::steady_clock::now();
+
+			// Get sensor data, if that fails work through the recovery steps
+			bool frameReceived = ( SerialCommands.nGetBXTransforms(false) == 1 );
+			if( !frameReceived ) frameReceived = linkFailed();
+
+			if( frameReceived )
 			{			
-				// Set local copy of current data
-				setCurrentSensorData();
+				linkRestored();
+
+				// Only frames that haven't been seen before go in the buffers
+				unsigned long replyFrameNumber;
+				schedulerTime receiveTime = boost::chrono::steady_clock::now();
+				if( getReplyFrameNumber(replyFrameNumber) &&
+					bxScheduler.frameReceived(replyFrameNumber, requestTime, receiveTime) )
+				{
+					// Time the frame from the device clock rather than the jittery reply
+					currentAcquisitionTime = frameClock.addSample(replyFrameNumber, receiveTime, SerialCommands.m_nLastReplyLength);
+
+					// Set local copy of current data
+					setCurrentSensorData();
+				}
+
+				// A tool has been plugged in or unplugged, bring the handles up to date between frames
+				if( SerialCommands.m_dtSystemInformation.bPortOccupied || SerialCommands.m_dtSystemInformation.bPortUnoccupied )
+				{
+					updateSensorHandles();
+				}
+				// Otherwise use the gap to fetch one sensor's deferred metadata
+				else if( !SerialCommands.PendingPortInformation.empty() )
+				{
+					fetchSensorMetadata();
+				}
 			}
 		}
 		
-		stopTrackMutex.unlock();	// Make sure stopMutex is unlocked
 		std::cout << "Serial Tracking thread terminated!" << std::endl;
 }
 
@@ -48,18 +132,253 @@ void serialThread::stop()
 {
 	std::cout << "Attempting to stop the  Serial threads..." << std::endl;
 	
-	// Lock mutex
-	boost::lock_guard<boost::mutex> lockTrack(stopTrackMutex);
-	stopTrackingFlag = true;
-
-	boost::lock_guard<boost::mutex> lockLog(stopLogMutex);
-	stopLoggingFlag = true;
+	// The tracking thread sees this as soon as its current BX reply completes, or straight away if it is waiting to send one
+	{
+		boost::lock_guard<boost::mutex> lock(trackingMutex);
+		stopTrackingFlag.store(true, boost::memory_order_release);
+	}
+	trackingCondition.notify_one();
 
 	std::cout << "Set Flags" << std::endl;
 }
 
+void serialThread::waitForNextRequest()
+{
+	schedulerTime requestTime = bxScheduler.nextRequestTime();
+
+	boost::unique_lock<boost::mutex> lock(trackingMutex);
+	while( !stopTrackingFlag.load(boost::memory_order_acquire) && boost::chrono::steady_clock::now() < requestTime )
+	{
+		trackingCondition.wait_until(lock, requestTime);
+	}
+}
+
+bool serialThread::getReplyFrameNumber(unsigned long &frameNumber)
+{
+	// Any handle that reported in this reply carries the frame number, disabled ones don't
+	for( size_t i = 0; i != SerialCommands.ActivatedPortHandles.size(); ++i )
+	{
+		const TransformInformation &transform = SerialCommands.m_dtHandleInformation[SerialCommands.ActivatedPortHandles[i]].Xfrms;
+
+		if( transform.ulFlags == TRANSFORM_VALID || transform.ulFlags == TRANSFORM_MISSING )
+		{
+			frameNumber = transform.ulFrameNumber;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void serialThread::setPhaseLockedScheduling(bool phaseLocked)
+{
+	phaseLockedScheduling = phaseLocked;
+}
+
+double serialThread::getFramePeriodMs()
+{
+	return bxScheduler.getFramePeriodMs();
+}
+
+unsigned long serialThread::getDuplicateFrames()
+{
+	return bxScheduler.getDuplicateFrames();
+}
+
+void serialThread::getClockSyncState(clockSyncState &state)
+{
+	frameClock.getState(state);
+}
+
+void serialThread::stopLogging()
+{
+	// Set under the mutex so the wake up can't be missed by a logger about to wait
+	boost::lock_guard<boost::mutex> lock(loggingMutex);
+	stopLoggingFlag.store(true, boost::memory_order_release);
+	loggingCondition.notify_one();
+}
+
+void serialThread::notifyLogging()
+{
+	// Empty critical section orders the push before the logger's check for data
+	{
+		boost::lock_guard<boost::mutex> lock(loggingMutex);
+	}
+	loggingCondition.notify_one();
+}
+
+void serialThread::stopDispatcher()
+{
+	// Set under the mutex so the wake up can't be missed by a dispatcher about to wait
+	boost::lock_guard<boost::mutex> lock(dispatcherMutex);
+	stopDispatcherFlag.store(true, boost::memory_order_release);
+	dispatcherCondition.notify_one();
+}
+
+void serialThread::notifyDispatcher()
+{
+	// Empty critical section orders the publish before the dispatcher's check for frames
+	{
+		boost::lock_guard<boost::mutex> lock(dispatcherMutex);
+	}
+	dispatcherCondition.notify_one();
+}
+
+void serialThread::runDispatcher()
+{
+	for(;;)
+	{
+		// Block until a dispatcher subscription has frames waiting or we are told to stop
+		{
+			boost::unique_lock<boost::mutex> lock(dispatcherMutex);
+			while( !stopDispatcherFlag.load(boost::memory_order_acquire) && !FrameDispatcher.dispatchPending() )
+			{
+				dispatcherCondition.wait(lock);
+			}
+		}
+
+		// Read the flag before delivering, frames published before the stop are still delivered
+		bool stopRequested = stopDispatcherFlag.load(boost::memory_order_acquire);
+
+		while( FrameDispatcher.dispatch() )
+		{
+		}
+
+		if( stopRequested ) break;
+	}
+}
+
+bool serialThread::linkFailed()
+{
+	// Time the outage from the first failed reply
+	if( consecutiveLinkFailures++ == 0 ) outageStart = boost::chrono::steady_clock::now();
+
+	// A single bad reply isn't a lost link
+	if( consecutiveLinkFailures < LINK_LOSS_FAILURES ) return false;
+
+	return recoverLink();
+}
+
+bool serialThread::recoverLink()
+{
+	if( consecutiveLinkFailures == LINK_LOSS_FAILURES )
+	{
+		std::cout << "Serial link lost, attempting recovery..." << std::endl;
+
+		boost::lock_guard<boost::mutex> lock(linkMetricsMutex);
+		++currentLinkMetrics.outages;
+	}
+
+	// First flush whatever is left of the last reply and resync on a new one
+	setLinkState(LINK_RESYNC);
+	SerialCommands.nResyncComPort();
+	if( SerialCommands.nGetBXTransforms(false) == 1 )
+	{
+		boost::lock_guard<boost::mutex> lock(linkMetricsMutex);
+		++currentLinkMetrics.resyncs;
+		return true;
+	}
+
+	if( stopTrackingFlag ) return false;
+
+	// Then a soft re-init, leave and re-enter tracking mode without touching the handles
+	setLinkState(LINK_REINIT);
+	SerialCommands.nResyncComPort();
+	SerialCommands.nStopTracking();
+	if( SerialCommands.nStartTracking() && SerialCommands.nGetBXTransforms(false) == 1 )
+	{
+		boost::lock_guard<boost::mutex> lock(linkMetricsMutex);
+		++currentLinkMetrics.reinits;
+		return true;
+	}
+
+	if( stopTrackingFlag || comPortName.empty() ) 
+	{
+		setLinkState(LINK_DOWN);
+		return false;
+	}
+
+	// A full reset blocks for seconds, so after one fails the next waits, the cheaper steps above are still tried every pass
+	if( resetBackoffMs > 0 && boost::chrono::steady_clock::now() < nextResetTime )
+	{
+		setLinkState(LINK_DOWN);
+		return false;
+	}
+
+	// Last resort, full hardware reset and reactivation. Replies take longer outside tracking so use the default timeout
+	setLinkState(LINK_RESET);
+	SerialCommands.setReadTimeout(DEFAULT_READ_TIMEOUT);
+	bool reset = connectToAurora(comPortName, comBaudRate, comHardwareHandshake) && SerialCommands.nActivateAllPorts(deferSensorMetadata) && SerialCommands.nStartTracking();
+	SerialCommands.setReadTimeout(linkTimeoutMs);
+
+	if( reset )
+	{
+		// Handles may have been renumbered by the reset
+		assignSensorSlots();
+		queueSessionSave();
+
+		if( SerialCommands.nGetBXTransforms(false) == 1 )
+		{
+			boost::lock_guard<boost::mutex> lock(linkMetricsMutex);
+			++currentLinkMetrics.resets;
+			return true;
+		}
+	}
+
+	resetBackoffMs = resetBackoffMs == 0 ? LINK_RESET_BACKOFF_MIN : std::min(resetBackoffMs * 2, LINK_RESET_BACKOFF_MAX);
+	nextResetTime = boost::chrono::steady_clock::now() + boost::chrono::milliseconds(resetBackoffMs);
+
+	std::cout << "Serial link recovery failed, next reset in " << resetBackoffMs << "ms!" << std::endl;
+	setLinkState(LINK_DOWN);
+	return false;
+}
+
+void serialThread::linkRestored()
+{
+	if( consecutiveLinkFailures == 0 ) return;
+
+	// Only record an outage if the link was declared lost
+	if( consecutiveLinkFailures >= LINK_LOSS_FAILURES )
+	{
+		double outageMs = boost::chrono::duration<double, boost::milli>(boost::chrono::steady_clock::now() - outageStart).count();
+
+		boost::lock_guard<boost::mutex> lock(linkMetricsMutex);
+		currentLinkMetrics.state = LINK_OK;
+		currentLinkMetrics.lastOutageMs = outageMs;
+		currentLinkMetrics.longestOutageMs = std::max(currentLinkMetrics.longestOutageMs, outageMs);
+		currentLinkMetrics.totalOutageMs += outageMs;
+
+		std::cout << "Serial link recovered after " << outageMs << "ms" << std::endl;
+	}
+
+	consecutiveLinkFailures = 0;
+	resetBackoffMs = 0;
+}
+
+void serialThread::setLinkState(linkRecoveryState state)
+{
+	boost::lock_guard<boost::mutex> lock(linkMetricsMutex);
+	currentLinkMetrics.state = state;
+}
+
+void serialThread::setLinkTimeout(unsigned int msTimeout)
+{
+	linkTimeoutMs = msTimeout;
+}
+
+void serialThread::getLinkMetrics(linkMetrics &metrics)
+{
+	boost::lock_guard<boost::mutex> lock(linkMetricsMutex);
+	metrics = currentLinkMetrics;
+}
+
 bool serialThread::connectToAurora(std::string &portName, std::string &baudRate, bool hardwareHandshake)
 {
+	// Keep the settings for recovering the link
+	comPortName = portName;
+	comBaudRate = baudRate;
+	comHardwareHandshake = hardwareHandshake;
+
 	// Reset to give clean slate
 	if( !serialThread::resetAurora(portName) ) return false;
 
@@ -106,216 +425,1076 @@ int serialThread::getNumOfSensors()
 	return numSensors;
 }
 
-void serialThread::activateSensors()
+void serialThread::activateSensors(bool deferMetadata)
 {
+	// With deferred metadata PHINF is left until tracking has started, which gets the first frame out sooner
+	deferSensorMetadata = deferMetadata;
+
 	// Activate sensor handles and enable them
-	SerialCommands.nActivateAllPorts();
+	SerialCommands.nActivateAllPorts(deferSensorMetadata);
 
 	// Get the number of sensors
 	setNumOfSensors();
 }
 
-void serialThread::setNumOfSensors()
+void serialThread::setSpareSensorSlots(int spareSlots)
 {
-	numSensors = SerialCommands.GetNumEnabledHandles();
+	spareSensorSlots = std::max(spareSlots, 0);
 }
 
-void serialThread::setLogFile(const std::string &logFile)
+void serialThread::setNumOfSensors()
 {
-	logFileName = logFile;
-}
+	// One slot per enabled handle plus the spares for hot-plugging
+	configureSensorSlots( int(SerialCommands.EnabledPortHandles.size()) + spareSensorSlots );
 
-std::string serialThread::getLogFile()
-{
-	return logFileName;
+	// Give every enabled handle a sensor slot
+	assignSensorSlots();
+	saveSession();
 }
 
-void serialThread::startTracking()
+void serialThread::configureSensorSlots(int slots)
 {
-	// Send command to Aurora to start tracking
-	SerialCommands.nStartTracking();
+	if( slots > MAX_NUM_OF_SENSORS )
+	{
+		std::cout << "Only " << MAX_NUM_OF_SENSORS << " sensors are supported!" << std::endl;
+		slots = MAX_NUM_OF_SENSORS;
+	}
 
-	// Start a tracking thread
-	TrackingThread = boost::thread(&serialThread::runTracking, this);
+	numSensors = slots;
 
-	// Start a logging thread
-	LoggingThread = boost::thread(&serialThread::writeSensorDataToLogFile, this);
+	// Drop any slots past the new width
+	for( int i = numSensors; i != MAX_NUM_OF_SENSORS; ++i )
+	{
+		sensorSlotHandles[i] = -1;
+		publishSensorMetadata(i);
+	}
 
+	// Size the frames, all the allocation happens here rather than per frame
+	currentSensorData.assign(numSensors, sensorRecord());
+	FrameBuffer.configure(numSensors);
+	FrameDispatcher.configure();
+	LatestSensorData.configure(numSensors);
+	SensorHealth.reset();
+	PoseHistory.reset();
+	PoseFilter.reset();
+	SensorStatistics.configure(numSensors, SensorStatistics.getWindow());
+	History.configure(numSensors, History.getMemoryBudget());
+	ControllerSpill.configure(numSensors);
+	PostProcessing.configure(numSensors);
 }
 
-void serialThread::stopTracking()
+void serialThread::assignSensorSlots()
 {
-	// Tell recording thread that we are to stop tracking, will block till thread terminates
-	stop();
+	// Vacate the slots of handles that are no longer enabled
+	for( int i = 0; i != numSensors; ++i )
+	{
+		if( sensorSlotHandles[i] < 0 ) continue;
 
-	std::cout << "waiting for serial threads to terminate..." << std::endl;
-	
-	// Wait for threads to terminate
-	TrackingThread.join();
-	LoggingThread.join();
+		if( std::find(SerialCommands.EnabledPortHandles.begin(), SerialCommands.EnabledPortHandles.end(), sensorSlotHandles[i]) == SerialCommands.EnabledPortHandles.end() )
+		{
+			std::cout << "Sensor in slot " << i << " removed!" << std::endl;
+			sensorSlotHandles[i] = -1;
+			publishSensorMetadata(i);
+		}
+	}
 
-	// Tell aurora to stop tracking
-	SerialCommands.nStopTracking();
+	// Put newly enabled handles in the first vacant slot
+	for( size_t j = 0; j != SerialCommands.EnabledPortHandles.size(); ++j )
+	{
+		int handle = SerialCommands.EnabledPortHandles[j];
 
-	// After everything has terminated set flag back to false state
-	stopTrackingFlag = false;
-	stopLoggingFlag = false;
+		boost::array<int, MAX_NUM_OF_SENSORS>::iterator slotsEnd = sensorSlotHandles.begin() + numSensors;
 
-	std::cout << "Serial Threads stopped!" << std::endl;
+		if( std::find(sensorSlotHandles.begin(), slotsEnd, handle) != slotsEnd ) continue;
+
+		boost::array<int, MAX_NUM_OF_SENSORS>::iterator vacantSlot = std::find(sensorSlotHandles.begin(), slotsEnd, -1);
+
+		if( vacantSlot == slotsEnd )
+		{
+			std::cout << "No free sensor slot for handle " << handle << ", reserve more with setSpareSensorSlots!" << std::endl;
+			continue;
+		}
+
+		*vacantSlot = handle;
+		std::cout << "Sensor added in slot " << (vacantSlot - sensorSlotHandles.begin()) << "!" << std::endl;
+		publishSensorMetadata(vacantSlot - sensorSlotHandles.begin());
+	}
 }
 
-void serialThread::setCurrentSensorData()
+void serialThread::updateSensorHandles()
 {
-	// Local variables for storing the data instant
-	logBufferUnit currentSensorDataLog;
-	bufferUnit  currentSensorData;
+	// Only touches the handles that changed, the rest keep tracking
+	if( !SerialCommands.nActivateNewPorts(deferSensorMetadata) )
+	{
+		std::cout << "Failed to update sensor handles!" << std::endl;
+	}
 
-	// Current handle holder
-	int currentHandle;
+	// Re-map the slots from what is now enabled, and keep the persisted session in step
+	assignSensorSlots();
+	queueSessionSave();
+}
 
-	// Set the number of sensors
-	numSensors = SerialCommands.ActivatedPortHandles.size();
+void serialThread::fetchSensorMetadata()
+{
+	int handle = SerialCommands.PendingPortInformation.front();
 
-	// Iterate over the activated port handles and set the postion data
-	for( int i = 0; i != numSensors; ++i )
+	// PHINF removes the handle from the pending list, drop it anyway on failure so it can't block the others
+	if( !SerialCommands.nGetPortInformation(handle) )
 	{
-		// If the number of sensors is greater than that supported just take first ones up to the max num.
-		if( i > MAX_NUM_OF_SENSORS ) break;		
-
-		currentHandle = SerialCommands.ActivatedPortHandles[i];
+		std::cout << "Failed to get information for handle " << handle << "!" << std::endl;
+		SerialCommands.PendingPortInformation.erase(SerialCommands.PendingPortInformation.begin());
+		return;
+	}
 
-		// Note no check is made to see if the data is valid, BAD FLOAT will be set if the data is not valid
-		currentSensorData[i].x = SerialCommands.m_dtHandleInformation[currentHandle].Xfrms.translation.x;
-		currentSensorData[i].y = SerialCommands.m_dtHandleInformation[currentHandle].Xfrms.translation.y;
-		currentSensorData[i].z = SerialCommands.m_dtHandleInformation[currentHandle].Xfrms.translation.z;
+	boost::array<int, MAX_NUM_OF_SENSORS>::iterator slot = std::find(sensorSlotHandles.begin(), sensorSlotHandles.end(), handle);
+	if( slot != sensorSlotHandles.end() ) publishSensorMetadata(slot - sensorSlotHandles.begin());
+}
 
-		// Check to see if sensor is broken
-		bool broken = SerialCommands.m_dtHandleInformation[currentHandle].HandleInfo.bBrokenSensor;
-		brokenSensors = brokenSensors || broken;
+void serialThread::publishSensorMetadata(int slot)
+{
+	int handle = sensorSlotHandles[slot];
 
-		// Set sensor status
-		boost::lock_guard<boost::mutex> lock(sensorStatusMutex);
-		sensorsValid[i] = !broken;
-	}
+	boost::lock_guard<boost::mutex> lock(sensorMetadataMutex);
+	sensorMetadata &metadata = sensorsMetadata[slot];
 
-	// Fill out the rest of the data with zeros for a bit of safety :)
-	if( numSensors < MAX_NUM_OF_SENSORS )
-	{
-		for( int i = numSensors; i != MAX_NUM_OF_SENSORS; ++i)
-		{
-			currentSensorData[i].x = 0;
-			currentSensorData[i].y = 0;
-			currentSensorData[i].z = 0;
+	// Tells the binary log to describe the slot again
+	sensorMetadataChanges.fetch_add(1, boost::memory_order_release);
 
-			boost::lock_guard<boost::mutex> lock(sensorStatusMutex);
-			sensorsValid[i] = false;
-		}
-	}
+	metadata.handle = handle;
 
-	// Copy the data over to the log buffer
-	currentSensorDataLog.sensorData = currentSensorData;
+	// Not ready for a vacant slot, or while the handle's PHINF is still pending
+	metadata.ready = ( handle >= 0 &&
+		std::find(SerialCommands.PendingPortInformation.begin(), SerialCommands.PendingPortInformation.end(), handle) == SerialCommands.PendingPortInformation.end() );
 
-	// Set frame number
-	if( numSensors > 0 ) 
+	if( !metadata.ready )
 	{
-		currentFrameNumber = SerialCommands.m_dtHandleInformation[currentHandle].Xfrms.ulFrameNumber;
-		currentSensorDataLog.frameNumber = SerialCommands.m_dtHandleInformation[currentHandle].Xfrms.ulFrameNumber;
+		metadata.toolType.clear();
+		metadata.manufacturer.clear();
+		metadata.serialNumber.clear();
+		metadata.revision.clear();
+		metadata.partNumber.clear();
+		metadata.physicalPort.clear();
+		return;
 	}
 
-	// Push the data to the buffers
-	LoggingCircularBuffer.push(currentSensorDataLog);
-	ControllerCircularBuffer.push(currentSensorDataLog);
-
+	const HandleInformation &info = SerialCommands.m_dtHandleInformation[handle];
+	metadata.toolType = info.szToolType;
+	metadata.manufacturer = info.szManufact;
+	metadata.serialNumber = info.szSerialNo;
+	metadata.revision = info.szRev;
+	metadata.partNumber = info.szPartNumber;
+	metadata.physicalPort = std::string(info.szPhysicalPort, strnlen(info.szPhysicalPort, sizeof(info.szPhysicalPort)));
 }
 
-void serialThread::writeSensorDataToLogFile()
+unsigned long serialThread::describeSensors(std::vector<sessionLogSensor> &sensors)
 {
-	// Local variables
-	std::ofstream logFileStream;	
-	logBufferUnit latestSensorData;
+	boost::lock_guard<boost::mutex> lock(sensorMetadataMutex);
 
-	// Open log file
-	logFileStream.open(logFileName, std::ofstream::app);
+	sensors.resize(numSensors);
 
-	if( logFileStream.is_open() )
+	for( int i = 0; i != numSensors; ++i )
 	{
-		// Get current time
-		boost::posix_time::ptime currentTime = boost::posix_time::microsec_clock::local_time();
-		long milliseconds = currentTime.time_of_day().total_milliseconds();
-
-		// Display a number representing the time started
-		logFileStream << "Starting Time:" << milliseconds << std::endl;
-
-		// Close log file
-		logFileStream.close();
+		const sensorMetadata &metadata = sensorsMetadata[i];
+		sessionLogSensor &sensor = sensors[i];
+
+		sensor.slot = i;
+		sensor.handle = metadata.handle;
+		sensor.ready = metadata.ready ? 1 : 0;
+		sensor.reserved = 0;
+		setSessionLogString(sensor.toolType, metadata.ready ? metadata.toolType : std::string());
+		setSessionLogString(sensor.manufacturer, metadata.ready ? metadata.manufacturer : std::string());
+		setSessionLogString(sensor.serialNumber, metadata.ready ? metadata.serialNumber : std::string());
+		setSessionLogString(sensor.revision, metadata.ready ? metadata.revision : std::string());
+		setSessionLogString(sensor.partNumber, metadata.ready ? metadata.partNumber : std::string());
+		setSessionLogString(sensor.physicalPort, metadata.ready ? metadata.physicalPort : std::string());
 	}
 
+	// Taken under the lock, so it matches the descriptions
+	return sensorMetadataChanges.load(boost::memory_order_relaxed);
+}
 
-	for(;;)
-	{
-		// Create a short break between logging sessions - sleep to wait for data
-		boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
-
-		// Check to see if we need to stop the thread
-		stopLogMutex.lock();
-		if( stopLoggingFlag ) break;
-		stopLogMutex.unlock();
-
-		while( LoggingCircularBuffer.pop(latestSensorData) )	// Continue until all the latest data has been recorded
-		{
+void serialThread::logSensorChanges(std::vector<sessionLogSensor> &loggedSensors, unsigned long &loggedChanges)
+{
+	std::vector<sessionLogSensor> sensors;
+	loggedChanges = describeSensors(sensors);
 
-			// Open log file
-			logFileStream.open(logFileName, std::ofstream::app);
+	// Only the slots that differ, a publish may not have changed anything
+	for( int i = 0; i != numSensors; ++i )
+	{
+		if( std::memcmp(&sensors[i], &loggedSensors[i], sizeof(sessionLogSensor)) == 0 ) continue;
 
-			if( logFileStream.is_open() )	// Checked if file opened correctly
-			{
-				// Put frame number
-				logFileStream << latestSensorData.frameNumber << "\t";
+		SessionLog.writeSensor(sensors[i]);
+		loggedSensors[i] = sensors[i];
+	}
+}
 
-				for( int i = 0; i != numSensors; ++i )
-				{
-					logFileStream << latestSensorData.sensorData[i].x << "\t" << latestSensorData.sensorData[i].y << "\t" << latestSensorData.sensorData[i].z << "\t";
-				}
+void serialThread::getSensorMetadata(boost::array<sensorMetadata, MAX_NUM_OF_SENSORS> &metadata)
+{
+	boost::lock_guard<boost::mutex> lock(sensorMetadataMutex);
+	metadata = sensorsMetadata;
+}
 
-				// Add new line at the end
-				logFileStream << std::endl;
+bool serialThread::sensorMetadataReady()
+{
+	boost::lock_guard<boost::mutex> lock(sensorMetadataMutex);
 
-				// Close log file
-				logFileStream.close();
-			}
-			else
-			{
-				std::cout << "Error opening sensor log file!" << std::endl;
-			}
-		}
+	for( int i = 0; i != MAX_NUM_OF_SENSORS; ++i )
+	{
+		if( sensorsMetadata[i].handle >= 0 && !sensorsMetadata[i].ready ) return false;
 	}
+	return true;
+}
 
-	std::cout << "Serial Logging thread stopped!" << std::endl;
+void serialThread::setLogFile(const std::string &logFile)
+{
+	logFileName = logFile;
+}
+
+std::string serialThread::getLogFile()
+{
+	return logFileName;
+}
 
-	stopLogMutex.unlock();	// Make sure mutex is unlocked
+void serialThread::setLogSyncInterval(unsigned int msInterval)
+{
+	logSyncIntervalMs = msInterval;
 }
 
-void serialThread::getSensorData(std::vector<logBufferUnit> &sensorDataStore)
+void serialThread::getLogStatistics(logWriterStatistics &statistics)
 {
-	// Temporary storage variable
-	logBufferUnit latestSensorData;
+	LogFile.getStatistics(statistics);
+}
 
-	// Get all the data that hasn't been stored yet
-	while( ControllerCircularBuffer.pop(latestSensorData) )
-	{
-		sensorDataStore.push_back(latestSensorData);
-	}
+void serialThread::setLogFormat(logFormat format)
+{
+	logFileFormat = format;
 }
 
-bool serialThread::anyBrokenSensors()
+logFormat serialThread::getLogFormat()
 {
-	// Return the flag
-	return brokenSensors;
+	return logFileFormat;
 }
 
-void serialThread::getSensorsStatus(boost::array<bool, MAX_NUM_OF_SENSORS> &sensorDataValid)
+void serialThread::startTracking()
+{
+	// Send command to Aurora to start tracking
+	SerialCommands.nStartTracking();
+
+	// Start acquiring
+	startThreads();
+
+	// The device is tracking now, record what is needed to resume
+	saveSession();
+}
+
+void serialThread::startThreads()
+{
+	trackingSuspended = false;
+
+	// Lock memory before the threads start so nothing they touch can be paged out
+	{
+		boost::lock_guard<boost::mutex> lock(threadPolicyMutex);
+		currentThreadPolicy.report.clear();
+		currentThreadPolicy.memoryLocked = requestedThreadPolicy.lockMemory && lockProcessMemory(currentThreadPolicy.report);
+	}
+	if( requestedThreadPolicy.lockMemory ) prefaultBuffers();
+
+	// Learn the frame period and the device clock afresh
+	bxScheduler.reset();
+	frameClock.reset();
+	frameClock.setLinkRate(atoi(comBaudRate.c_str()));
+
+	// Short reply timeout so a lost link is noticed within a few frames
+	consecutiveLinkFailures = 0;
+	resetBackoffMs = 0;
+	SerialCommands.setReadTimeout(linkTimeoutMs);
+
+	// Post-processing first, the tracking thread hands it every frame
+	PostProcessing.start(postProcessingThreads);
+
+	// Start a tracking thread
+	TrackingThread = boost::thread(&serialThread::runTracking, this);
+
+	// Start a logging thread
+	LoggingThread = boost::thread(&serialThread::writeSensorDataToLogFile, this);
+
+	// Start the callback dispatcher thread
+	DispatcherThread = boost::thread(&serialThread::runDispatcher, this);
+
+}
+
+void serialThread::stopTracking()
+{
+	stopThreads();
+
+	// Tell aurora to stop tracking
+	SerialCommands.nStopTracking();
+
+	// Nothing left to resume
+	if( !sessionFileName.empty() ) std::remove(sessionFileName.c_str());
+}
+
+void serialThread::suspendTracking()
+{
+	// Stop acquiring but leave the Aurora tracking, and the session file in place, for the next process to resume
+	stopThreads();
+	trackingSuspended = true;
+}
+
+void serialThread::stopThreads()
+{
+	// Tell recording thread that we are to stop tracking, will block till thread terminates
+	stop();
+
+	std::cout << "waiting for serial threads to terminate..." << std::endl;
+	
+	// Wait for the tracking thread first so the logger can write out every frame it pushed
+	TrackingThread.join();
+
+	// Finish off the frames still being processed, they may yet be published
+	PostProcessing.stop();
+
+	stopLogging();
+	LoggingThread.join();
+
+	stopDispatcher();
+	DispatcherThread.join();
+
+	// Back to the setup mode timeout
+	SerialCommands.setReadTimeout(DEFAULT_READ_TIMEOUT);
+
+	// After everything has terminated set flag back to false state
+	stopTrackingFlag.store(false);
+	stopLoggingFlag.store(false);
+	stopDispatcherFlag.store(false);
+
+	std::cout << "Serial Threads stopped!" << std::endl;
+}
+
+void serialThread::setThreadPolicy(const threadPolicy &policy)
+{
+	requestedThreadPolicy = policy;
+}
+
+void serialThread::getAppliedThreadPolicy(appliedThreadPolicy &applied)
+{
+	boost::lock_guard<boost::mutex> lock(threadPolicyMutex);
+	applied = currentThreadPolicy;
+}
+
+void serialThread::applyThreadPolicy(threadScheduling scheduling, int priority, int cpu, bool &schedulingApplied, bool &affinityApplied)
+{
+	std::string report;
+
+	// Pin first so the thread's pages get faulted in on its own CPU's node
+	bool affinity = setCurrentThreadAffinity(cpu, report);
+	bool realTime = setCurrentThreadScheduling(scheduling, priority, report);
+
+	if( requestedThreadPolicy.lockMemory ) prefaultCurrentThreadStack();
+
+	// Failures only cost latency, carry on with whatever could be applied
+	if( !report.empty() ) std::cout << report;
+
+	boost::lock_guard<boost::mutex> lock(threadPolicyMutex);
+	schedulingApplied = realTime && scheduling != SCHEDULING_DEFAULT;
+	affinityApplied = affinity && cpu >= 0;
+	currentThreadPolicy.report += report;
+}
+
+void serialThread::prefaultBuffers()
+{
+	// Only while the threads are stopped. Once a frame has been published the pages are resident and may hold unread data
+	if( FrameBuffer.getPublished() == 0 ) FrameBuffer.prefault();
+}
+
+void serialThread::setSessionFile(const std::string &sessionFile)
+{
+	sessionFileName = sessionFile;
+}
+
+std::string serialThread::getSessionFile()
+{
+	return sessionFileName;
+}
+
+void serialThread::saveSession()
+{
+	if( sessionFileName.empty() ) return;
+
+	std::string session;
+	formatSession(session);
+	writeSessionFile(session);
+}
+
+void serialThread::queueSessionSave()
+{
+	if( sessionFileName.empty() ) return;
+
+	// Only the latest matters, an earlier one not yet written is replaced
+	{
+		boost::lock_guard<boost::mutex> lock(sessionMutex);
+		formatSession(pendingSession);
+	}
+	sessionSavePending.store(true, boost::memory_order_release);
+	notifyLogging();
+}
+
+void serialThread::writeSessionFile(const std::string &session)
+{
+	std::ofstream sessionFileStream(sessionFileName.c_str(), std::ofstream::trunc);
+
+	if( !sessionFileStream.is_open() )
+	{
+		std::cout << "Error opening session file!" << std::endl;
+		return;
+	}
+
+	sessionFileStream << session;
+}
+
+void serialThread::formatSession(std::string &session)
+{
+	std::ostringstream sessionFileStream;
+
+	sessionFileStream << "port " << comPortName << std::endl;
+	sessionFileStream << "baud " << comBaudRate << std::endl;
+	sessionFileStream << "handshake " << comHardwareHandshake << std::endl;
+
+	// Enabled handles
+	sessionFileStream << "handles " << SerialCommands.EnabledPortHandles.size();
+	for( size_t i = 0; i != SerialCommands.EnabledPortHandles.size(); ++i )
+	{
+		sessionFileStream << " " << SerialCommands.EnabledPortHandles[i];
+	}
+	sessionFileStream << std::endl;
+
+	// Handle held by each sensor slot
+	sessionFileStream << "slots " << numSensors;
+	for( int i = 0; i != numSensors; ++i )
+	{
+		sessionFileStream << " " << sensorSlotHandles[i];
+	}
+	sessionFileStream << std::endl;
+
+	session = sessionFileStream.str();
+}
+
+bool serialThread::resumeSession(std::string &portName)
+{
+	if( sessionFileName.empty() ) return false;
+
+	std::ifstream sessionFileStream(sessionFileName.c_str());
+	if( !sessionFileStream.is_open() ) return false;
+
+	// Read back the saved session
+	std::string key, savedPort, savedBaud;
+	bool savedHandshake = false;
+	std::vector<int> savedHandles;
+	boost::array<int, MAX_NUM_OF_SENSORS> savedSlots;
+	savedSlots.fill(-1);
+	int savedNumSensors = 0;
+
+	while( sessionFileStream >> key )
+	{
+		if( key == "port" ) sessionFileStream >> savedPort;
+		else if( key == "baud" ) sessionFileStream >> savedBaud;
+		else if( key == "handshake" ) sessionFileStream >> savedHandshake;
+		else if( key == "handles" || key == "slots" )
+		{
+			size_t count = 0;
+			sessionFileStream >> count;
+			if( key == "slots" ) savedNumSensors = int(count);
+			for( size_t i = 0; i != count && sessionFileStream; ++i )
+			{
+				int handle;
+				sessionFileStream >> handle;
+				if( key == "handles" ) savedHandles.push_back(handle);
+				else if( i < MAX_NUM_OF_SENSORS ) savedSlots[i] = handle;
+			}
+		}
+	}
+
+	// Only resume the session on the port it was saved from
+	if( savedBaud.empty() || savedPort != portName ) return false;
+
+	// Open the port at the saved rate, no serial break as that would reset the Aurora
+	SerialCommands.nCloseComPorts();
+	if( !SerialCommands.nOpenComPort(portName) ) return false;
+	SerialCommands.nSetCompCommParms( atoi(savedBaud.c_str()), savedHandshake );
+
+	// Probe with a BX, it only succeeds if the Aurora is still tracking at this rate
+	SerialCommands.setReadTimeout(linkTimeoutMs);
+	SerialCommands.nResyncComPort();
+	bool tracking = ( SerialCommands.nGetBXTransforms(false) == 1 );
+
+	if( tracking ) tracking = ( SerialCommands.nGetEnabledPortHandles() == 1 );
+
+	SerialCommands.setReadTimeout(DEFAULT_READ_TIMEOUT);
+
+	if( !tracking )
+	{
+		std::cout << "Aurora is not tracking, session can't be resumed!" << std::endl;
+		return false;
+	}
+
+	if( SerialCommands.EnabledPortHandles != savedHandles )
+	{
+		std::cout << "Enabled handles have changed since the session was saved!" << std::endl;
+	}
+
+	// Keep the recovery settings
+	comPortName = savedPort;
+	comBaudRate = savedBaud;
+	comHardwareHandshake = savedHandshake;
+
+	// PHINF wasn't read in this process, fetch it between frames
+	SerialCommands.PendingPortInformation = SerialCommands.EnabledPortHandles;
+
+	// Restore the frame width and the slots, then reconcile with what is enabled now
+	configureSensorSlots(savedNumSensors);
+	for( int i = 0; i != numSensors; ++i )
+	{
+		sensorSlotHandles[i] = savedSlots[i];
+	}
+	for( int i = 0; i != MAX_NUM_OF_SENSORS; ++i )
+	{
+		publishSensorMetadata(i);
+	}
+	assignSensorSlots();
+	saveSession();
+
+	// Straight back to acquiring, no reset or TSTART
+	startThreads();
+
+	std::cout << "Resumed tracking session!" << std::endl;
+
+	return true;
+}
+
+void serialThread::setCurrentSensorData()
+{
+	// Header for the data instant, the sensor data itself goes in the preallocated currentSensorData
+	sensorFrameHeader currentSensorDataHeader;
+
+	// Current handle holder
+	int currentHandle;
+	int frameHandle = -1;
+
+	// Iterate over the sensor slots and set the postion data
+	for( int i = 0; i != numSensors; ++i )
+	{
+		currentHandle = sensorSlotHandles[i];
+
+		// Vacant slots, and handles that are not in this reply yet (just plugged in), are filled with zeros for a bit of safety :)
+		if( currentHandle < 0 ||
+			std::find(SerialCommands.ActivatedPortHandles.begin(), SerialCommands.ActivatedPortHandles.end(), currentHandle) == SerialCommands.ActivatedPortHandles.end() )
+		{
+			std::memset(&currentSensorData[i], 0, sizeof(sensorRecord));
+			currentSensorData[i].status = SENSOR_SLOT_EMPTY;
+			continue;
+		}
+
+		if( frameHandle < 0 ) frameHandle = currentHandle;
+
+		const TransformInformation &transform = SerialCommands.m_dtHandleInformation[currentHandle].Xfrms;
+
+		// Note no check is made to see if the data is valid, BAD FLOAT will be set if the data is not valid
+		currentSensorData[i].rotation = transform.rotation;
+		currentSensorData[i].translation = transform.translation;
+		currentSensorData[i].error = transform.fError;
+		currentSensorData[i].frameNumber = (unsigned int)transform.ulFrameNumber;
+
+		// Raw status word plus why there is no pose
+		currentSensorData[i].status = (unsigned int)( transform.ulStatus & 0xFFFF );
+		if( transform.ulFlags == TRANSFORM_MISSING ) currentSensorData[i].status |= SENSOR_TRANSFORM_MISSING;
+		if( transform.ulFlags == TRANSFORM_DISABLED ) currentSensorData[i].status |= SENSOR_TRANSFORM_DISABLED;
+
+		// Check to see if sensor is broken
+		if( SerialCommands.m_dtHandleInformation[currentHandle].HandleInfo.bBrokenSensor ) currentSensorData[i].status |= SENSOR_BROKEN;
+	}
+
+	// Set frame number
+	if( frameHandle >= 0 ) 
+	{
+		currentFrameNumber = SerialCommands.m_dtHandleInformation[frameHandle].Xfrms.ulFrameNumber;
+	}
+	currentSensorDataHeader.frameNumber = currentFrameNumber;
+	currentSensorDataHeader.systemStatus = SerialCommands.m_dtSystemInformation.uSystemStatus;
+	currentSensorDataHeader.acquisitionTime = boost::chrono::duration_cast<boost::chrono::nanoseconds>(currentAcquisitionTime.time_since_epoch()).count();
+	currentSensorDataHeader.numSensors = numSensors;
+
+	// Everything else is done by the post-processing stages, in frame order
+	PostProcessing.submit(currentSensorDataHeader, currentSensorData.empty() ? NULL : &currentSensorData[0]);
+}
+
+void serialThread::publishFrame(pipelineFrame &frame)
+{
+	const sensorFrameHeader &header = frame.frame.header;
+	const sensorRecord *sensors = frame.frame.sensors.empty() ? NULL : &frame.frame.sensors[0];
+
+	// Publish each slot's status, changes are queued as events against this frame
+	for( int i = 0; i != numSensors; ++i )
+	{
+		SensorHealth.update(i, sensors[i].status, header.frameNumber);
+	}
+
+	// Write the frame once, every subscriber reads it from the ring or its own mailbox.
+	// A full mailbox only counts the frame as dropped for that subscriber
+	FrameBuffer.publish(header, sensors);
+	LatestSensorData.publish(header, sensors);
+
+	// Wake the logger, there is always something new for it
+	notifyLogging();
+}
+
+void serialThread::spillFrame(pipelineFrame &frame)
+{
+	// Straight after publishing, in order and without a queue in between that could drop frames. Any it can't hold are counted as lost
+	if( controllerSpilling ) ControllerSpill.push(frame.frame.view());
+}
+
+void serialThread::trackPoses(pipelineFrame &frame)
+{
+	const sensorRecord *sensors = frame.frame.sensors.empty() ? NULL : &frame.frame.sensors[0];
+
+	PoseHistory.addFrame(frame.frame.header, sensors);
+
+	// Smooth and predict over the time the frame took to get here
+	if( poseFiltering )
+	{
+		PoseFilter.addFrame(frame.frame.header, sensors,
+			boost::chrono::duration_cast<boost::chrono::nanoseconds>(boost::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+}
+
+void serialThread::updateStatistics(pipelineFrame &frame)
+{
+	SensorStatistics.addFrame(frame.frame.header, frame.frame.sensors.empty() ? NULL : &frame.frame.sensors[0]);
+}
+
+void serialThread::deliverFrame(pipelineFrame &frame)
+{
+	// Inline callbacks see the frame as it was read, and decimated streams are down-sampled here once for all
+	bool decimatedQueued = FrameDispatcher.deliver(frame.frame.view());
+
+	// Low rate dispatcher subscriptions only wake it when a decimated frame is waiting
+	if( FrameDispatcher.hasFullRateSubscriptions() || decimatedQueued ) notifyDispatcher();
+}
+
+void serialThread::writeSensorDataToLogFile()
+{
+	// One batch of frames, allocated before the first frame arrives
+	std::vector<sensorFrameHeader> headers(LOG_BATCH_FRAMES);
+	std::vector<sensorRecord> records(LOG_BATCH_FRAMES * std::max(numSensors, 1));
+
+	// Priority and CPU pinning, if requested
+	applyThreadPolicy(requestedThreadPolicy.loggingScheduling, requestedThreadPolicy.loggingPriority, requestedThreadPolicy.loggingCpu,
+		currentThreadPolicy.loggingScheduling, currentThreadPolicy.loggingAffinity);
+
+	// Open log file, it stays open until the thread stops
+	LogFile.setSyncInterval(logSyncIntervalMs);
+	bool binaryLog = ( logFileFormat == LOG_FORMAT_BINARY );
+	bool timedLog = ( logFileFormat == LOG_FORMAT_TEXT_TIMED );
+
+	// Slots as the binary log last described them
+	std::vector<sessionLogSensor> loggedSensors;
+	unsigned long loggedMetadataChanges = 0;
+
+	if( binaryLog && LogFile.open(logFileName, false, true) )
+	{
+		// Describe every slot as it is now, PHINF may not have been read for all of them yet. Later changes go in among the frames
+		loggedMetadataChanges = describeSensors(loggedSensors);
+
+		// Start time on the frames' steady clock and on the wall clock
+		boost::int64_t steadyNanoseconds = boost::chrono::duration_cast<boost::chrono::nanoseconds>(boost::chrono::steady_clock::now().time_since_epoch()).count();
+		boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+		boost::int64_t wallMicroseconds = ( boost::posix_time::microsec_clock::universal_time() - epoch ).total_microseconds();
+
+		if( SessionLog.begin(loggedSensors, steadyNanoseconds, wallMicroseconds) ) LogFile.commit();
+		else LogFile.close();
+	}
+	else if( !binaryLog && LogFile.open(logFileName) )
+	{
+		// Get current time
+		boost::posix_time::ptime currentTime = boost::posix_time::microsec_clock::local_time();
+		long milliseconds = currentTime.time_of_day().total_milliseconds();
+
+		// Display a number representing the time started
+		LogFile.print("Starting Time:%ld\n", milliseconds);
+
+		// Same instant on the steady clock the frames are timed with, in microseconds
+		if( timedLog )
+		{
+			boost::int64_t steadyMicroseconds = boost::chrono::duration_cast<boost::chrono::microseconds>(boost::chrono::steady_clock::now().time_since_epoch()).count();
+			LogFile.print("Steady Clock Time:%lld\n", (long long)steadyMicroseconds);
+		}
+
+		LogFile.commit();
+	}
+	else
+	{
+		std::cout << "Error opening sensor log file!" << std::endl;
+	}
+
+
+	for(;;)
+	{
+		// Block until the tracking thread has pushed data or we are told to stop
+		{
+			boost::unique_lock<boost::mutex> lock(loggingMutex);
+			while( !stopLoggingFlag.load(boost::memory_order_acquire) && FrameBuffer.getLag(loggingSubscriber) == 0 &&
+				!sessionSavePending.load(boost::memory_order_acquire) )
+			{
+				loggingCondition.wait(lock);
+			}
+		}
+
+		// Read the flag before draining, anything pushed before the stop is then written out
+		bool stopRequested = stopLoggingFlag.load(boost::memory_order_acquire);
+
+		// Session changes from the tracking thread
+		if( sessionSavePending.exchange(false, boost::memory_order_acquire) )
+		{
+			std::string session;
+			{
+				boost::lock_guard<boost::mutex> lock(sessionMutex);
+				session.swap(pendingSession);
+			}
+			writeSessionFile(session);
+		}
+
+		// Everything waiting goes into the buffer, then out to the file in one commit
+		size_t batch;
+		bool written = false;
+
+		while( ( batch = FrameBuffer.popBulk(loggingSubscriber, &headers[0], &records[0], LOG_BATCH_FRAMES) ) > 0 )	// Continue until all the latest data has been recorded
+		{
+			if( !LogFile.isOpen() ) continue;
+
+			// Fixed size records, written as they are, after any slot that has changed since the last batch
+			if( binaryLog )
+			{
+				if( sensorMetadataChanges.load(boost::memory_order_acquire) != loggedMetadataChanges ) logSensorChanges(loggedSensors, loggedMetadataChanges);
+				SessionLog.writeFrames(&headers[0], &records[0], batch);
+				written = true;
+				continue;
+			}
+
+			for( size_t n = 0; n != batch; ++n )
+			{
+				// Put frame number, then the estimated steady clock time it was measured in microseconds
+				LogFile.print("%lu\t", headers[n].frameNumber);
+				if( timedLog ) LogFile.print("%lld\t", (long long)( headers[n].acquisitionTime / 1000 ));
+
+				for( int i = 0; i != numSensors; ++i )
+				{
+					const Position3d &position = records[n * numSensors + i].translation;
+					LogFile.print("%g\t%g\t%g\t", position.x, position.y, position.z);
+				}
+
+				// Add new line at the end
+				LogFile.print("\n");
+			}
+
+			written = true;
+		}
+
+		if( written ) LogFile.commit();
+
+		// Check to see if we need to stop the thread
+		if( stopRequested ) break;
+	}
+
+	// Index for the binary log, then flushed and synced, so every frame published before the stop is on the disk
+	if( binaryLog && LogFile.isOpen() ) SessionLog.end();
+	LogFile.close();
+
+	std::cout << "Serial Logging thread stopped!" << std::endl;
+}
+
+void serialThread::getSensorData(std::vector<sensorFrame> &sensorDataStore)
+{
+	// Temporary storage variable
+	sensorFrame latestSensorData(numSensors);
+
+	// Get all the data that hasn't been stored yet
+	if( controllerSpilling )
+	{
+		while( ControllerSpill.pop(latestSensorData) )
+		{
+			sensorDataStore.push_back(latestSensorData);
+		}
+		return;
+	}
+
+	while( FrameBuffer.pop(controllerSubscriber, latestSensorData) )
+	{
+		sensorDataStore.push_back(latestSensorData);
+	}
+}
+
+void serialThread::getSensorData(std::vector<logBufferUnit> &sensorDataStore)
+{
+	// Taken as full frames, then cut down to the positions
+	std::vector<sensorFrame> frames;
+	getSensorData(frames);
+
+	Position3d noPosition = { 0.0f, 0.0f, 0.0f };
+
+	for( size_t n = 0; n != frames.size(); ++n )
+	{
+		logBufferUnit unit;
+		unit.frameNumber = frames[n].header.frameNumber;
+		unit.sensorData.fill(noPosition);
+
+		for( int i = 0; i != frames[n].getNumSensors(); ++i )
+		{
+			unit.sensorData[i] = frames[n].sensors[i].translation;
+		}
+
+		sensorDataStore.push_back(unit);
+	}
+}
+
+bool serialThread::getSensorPoseAt(int slot, schedulerTime time, sensorPose &pose)
+{
+	return PoseHistory.getPose(slot, boost::chrono::duration_cast<boost::chrono::nanoseconds>(time.time_since_epoch()).count(), pose);
+}
+
+unsigned int serialThread::getSensorPosesAt(schedulerTime time, boost::array<sensorPose, MAX_NUM_OF_SENSORS> &poses)
+{
+	boost::int64_t queryTime = boost::chrono::duration_cast<boost::chrono::nanoseconds>(time.time_since_epoch()).count();
+	unsigned int found = 0;
+
+	for( int i = 0; i != numSensors; ++i )
+	{
+		if( PoseHistory.getPose(i, queryTime, poses[i]) ) found |= 1u << i;
+	}
+
+	return found;
+}
+
+void serialThread::setPoseFilter(bool enable, const poseFilterSettings &settings)
+{
+	// Only while stopped, the tracking thread reads these without locking
+	poseFiltering = enable;
+	PoseFilter.setSettings(settings);
+}
+
+void serialThread::setStatisticsWindow(unsigned int window)
+{
+	SensorStatistics.configure(numSensors, window);
+}
+
+bool serialThread::getSensorStatistics(int slot, sensorStatistics &statistics)
+{
+	return SensorStatistics.getStatistics(slot, statistics);
+}
+
+bool serialThread::setHistoryBudget(size_t memoryBudget)
+{
+	// Off the dispatcher while it is resized
+	if( historySubscription >= 0 ) FrameDispatcher.unsubscribe(historySubscription);
+	historySubscription = -1;
+
+	if( !History.configure(numSensors, memoryBudget) ) return false;
+
+	// Compressing a chunk takes a while, so it is never done on the tracking thread
+	if( memoryBudget > 0 )
+		historySubscription = FrameDispatcher.subscribe(boost::bind(&frameHistory::addFrame, &History, _1), EXECUTE_DISPATCHER, BUFFER_SIZE);
+
+	return memoryBudget == 0 || historySubscription >= 0;
+}
+
+size_t serialThread::getHistoryByFrameNumber(unsigned long firstFrame, unsigned long lastFrame, std::vector<sensorFrame> &frames)
+{
+	return History.getFramesByNumber(firstFrame, lastFrame, frames);
+}
+
+size_t serialThread::getHistoryByTime(schedulerTime fromTime, schedulerTime toTime, std::vector<sensorFrame> &frames)
+{
+	return History.getFramesByTime(boost::chrono::duration_cast<boost::chrono::nanoseconds>(fromTime.time_since_epoch()).count(),
+		boost::chrono::duration_cast<boost::chrono::nanoseconds>(toTime.time_since_epoch()).count(), frames);
+}
+
+void serialThread::getHistoryInfo(historyInfo &info)
+{
+	History.getInfo(info);
+}
+
+void serialThread::setPostProcessingThreads(int threads)
+{
+	postProcessingThreads = std::max(0, std::min(threads, MAX_PIPELINE_THREADS));
+}
+
+void serialThread::getPostProcessingStatistics(pipelineStatistics &statistics)
+{
+	PostProcessing.getStatistics(statistics);
+}
+
+bool serialThread::getFilteredSensorPose(int slot, filteredPose &pose)
+{
+	return PoseFilter.getFilteredPose(slot, pose);
+}
+
+bool serialThread::predictSensorPose(int slot, schedulerTime time, sensorPose &pose)
+{
+	return PoseFilter.predictPose(slot, boost::chrono::duration_cast<boost::chrono::nanoseconds>(time.time_since_epoch()).count(), pose);
+}
+
+size_t serialThread::getSensorData(sensorFrameHeader *headers, sensorRecord *sensors, size_t maxFrames)
+{
+	if( controllerSpilling ) return ControllerSpill.popBulk(headers, sensors, maxFrames);
+
+	return FrameBuffer.popBulk(controllerSubscriber, headers, sensors, maxFrames);
+}
+
+bool serialThread::getLatestSensorData(sensorFrame &latestSensorData)
+{
+	return LatestSensorData.read(latestSensorData);
+}
+
+bool serialThread::waitForSensorData(boost::uint64_t &sequence, sensorFrame &latestSensorData, unsigned int msTimeout)
+{
+	// Blocks until a frame published after sequence arrives
+	return LatestSensorData.waitForNewer(sequence, latestSensorData, msTimeout);
+}
+
+int serialThread::subscribeFrames(const frameCallback &callback, frameExecutor executor, size_t maxLag)
+{
+	return FrameDispatcher.subscribe(callback, executor, maxLag);
+}
+
+void serialThread::unsubscribeFrames(int subscription)
+{
+	FrameDispatcher.unsubscribe(subscription);
+}
+
+int serialThread::subscribeDecimatedFrames(const frameCallback &callback, const frameDecimation &decimation, frameExecutor executor)
+{
+	return FrameDispatcher.subscribe(callback, executor, BUFFER_SIZE, &decimation);
+}
+
+unsigned long serialThread::getSubscriptionOverruns(int subscription)
+{
+	return FrameDispatcher.getOverruns(subscription);
+}
+
+int serialThread::addFrameSubscriber()
+{
+	int subscriber = FrameBuffer.subscribe();
+
+	if( subscriber < 0 ) std::cout << "No free frame subscribers!" << std::endl;
+
+	return subscriber;
+}
+
+void serialThread::removeFrameSubscriber(int subscriber)
+{
+	// The logger and the controller keep theirs
+	if( subscriber == loggingSubscriber || subscriber == controllerSubscriber ) return;
+
+	FrameBuffer.unsubscribe(subscriber);
+}
+
+bool serialThread::peekFrame(int subscriber, sensorFrameView &view)
+{
+	return FrameBuffer.peek(subscriber, view);
+}
+
+bool serialThread::releaseFrame(int subscriber)
+{
+	return FrameBuffer.release(subscriber);
+}
+
+int serialThread::getLoggingSubscriber()
+{
+	return loggingSubscriber;
+}
+
+int serialThread::getControllerSubscriber()
+{
+	return controllerSubscriber;
+}
+
+void serialThread::setSubscriberOverflowPolicy(int subscriber, overflowPolicy policy, unsigned int msBlock)
+{
+	FrameBuffer.setOverflowPolicy(subscriber, policy, msBlock);
+}
+
+void serialThread::getSubscriberStatistics(int subscriber, queueStatistics &statistics)
+{
+	FrameBuffer.getStatistics(subscriber, statistics);
+}
+
+bool serialThread::setControllerSpillFile(const std::string &spillFile)
+{
+	// Frames the controller hadn't read yet are dropped, getControllerSpillStatistics counts them as lost until another file is opened
+	controllerSpilling = false;
+	ControllerSpill.close();
+
+	if( spillFile.empty() ) return true;
+
+	if( !ControllerSpill.open(spillFile) ) return false;
+	ControllerSpill.configure(numSensors);
+
+	// The spill stage takes every frame published, so none can be skipped on the way however far the controller falls behind.
+	// The controller's ring cursor goes unread meanwhile, so it mustn't have a mailbox to fill
+	FrameBuffer.setOverflowPolicy(controllerSubscriber, OVERFLOW_OVERWRITE_OLDEST, 0);
+	controllerSpilling = true;
+
+	return true;
+}
+
+void serialThread::getControllerSpillStatistics(spillStatistics &statistics)
+{
+	ControllerSpill.getStatistics(statistics);
+}
+
+size_t serialThread::getSubscriberLag(int subscriber)
+{
+	return FrameBuffer.getLag(subscriber);
+}
+
+unsigned long serialThread::getSubscriberOverruns(int subscriber)
+{
+	return FrameBuffer.getOverruns(subscriber);
+}
+
+bool serialThread::anyBrokenSensors()
+{
+	// Any slot broken in the latest frame
+	return SensorHealth.getBrokenSlots() != 0;
+}
+
+void serialThread::getSensorsStatus(boost::array<bool, MAX_NUM_OF_SENSORS> &sensorDataValid)
+{
+	// Valid unless the slot is empty or the sensor is broken
+	for( int i = 0; i != MAX_NUM_OF_SENSORS; ++i )
+	{
+		sensorDataValid[i] = !( SensorHealth.getStatus(i) & SENSOR_INVALID_BITS );
+	}
+}
+
+void serialThread::getSensorsStatus(boost::array<unsigned int, MAX_NUM_OF_SENSORS> &sensorStatus)
+{
+	for( int i = 0; i != MAX_NUM_OF_SENSORS; ++i )
+	{
+		sensorStatus[i] = SensorHealth.getStatus(i);
+	}
+}
+
+bool serialThread::getSensorStatusEvent(sensorStatusEvent &event)
+{
+	return SensorHealth.popEvent(event);
+}
+
+bool serialThread::waitForSensorStatusEvent(sensorStatusEvent &event, unsigned int msTimeout)
+{
+	return SensorHealth.waitForEvent(event, msTimeout);
+}
+
+unsigned long serialThread::getDroppedSensorStatusEvents()
 {
-	// Wait till mutex becomes available and then status'
-	boost::lock_guard<boost::mutex> lock(sensorStatusMutex);
-	sensorDataValid = sensorsValid;
+	return SensorHealth.getDroppedEvents();
 }
\ No newline at end of file
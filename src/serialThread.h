@@ -4,20 +4,47 @@
 //#include <qmutex.h>
 #include "CommandHandling.h"
 #include "serialCommunicator.h"
+#include "threadPolicy.h"
+#include "frameScheduler.h"
+#include "sensorFrame.h"
+#include "broadcastRing.h"
+#include "latestFrame.h"
+#include "frameDispatcher.h"
+#include "sensorHealth.h"
+#include "clockSync.h"
+#include "poseInterpolator.h"
+#include "poseFilter.h"
+#include "windowedStatistics.h"
+#include "frameHistory.h"
+#include "spillQueue.h"
+#include "framePipeline.h"
+#include "logWriter.h"
+#include "sessionLog.h"
 #include <boost/thread.hpp>
+#include <boost/atomic.hpp>
 #include <boost/array.hpp>
-#include <boost/lockfree/queue.hpp>
-#include <boost/circular_buffer.hpp>
-#include <boost/lockfree/spsc_queue.hpp>
 
 #pragma once
 
 // Define constants
-const int MAX_NUM_OF_SENSORS = 4; 
 const int BUFFER_SIZE = 4096;
-const int LOG_BUFFER_SIZE = 1024;
 
-// Define a single unit in the buffer, i.e. one whole set of sensor data
+// Most frames the logger takes from the ring at a time
+const size_t LOG_BATCH_FRAMES = 256;
+
+// Log file formats
+enum logFormat
+{
+	LOG_FORMAT_TEXT,		// Tab separated positions, appended to the file
+	LOG_FORMAT_BINARY,		// Indexed session log, see sessionLog.h. The file is started afresh each time tracking starts
+	LOG_FORMAT_TEXT_TIMED	// Text with a "Steady Clock Time:" line after the starting time, and each frame's acquisition time in microseconds after its number
+};
+
+// Post-processing constants
+const size_t PIPELINE_DEPTH = 64;				// Frames being post-processed before the tracking thread waits
+const int DEFAULT_PIPELINE_THREADS = 2;
+
+// Define a single unit in the buffer, i.e. one whole set of sensor positions
 // Note boost::array is used so typedef does not decay into a pointer (awkward syntax)
 typedef boost::array<Position3d, MAX_NUM_OF_SENSORS> bufferUnit;
 
@@ -28,6 +55,50 @@ typedef struct logFileBufferTypeStruct
 	bufferUnit sensorData;
 } logBufferUnit;
 
+// Slots left free at activation for tools plugged in later, one per Aurora tool port
+const int DEFAULT_SPARE_SENSOR_SLOTS = 4;
+
+// Link recovery constants
+const int LINK_LOSS_FAILURES = 2;				// Consecutive failed BX replies before the link is declared lost
+const unsigned int DEFAULT_LINK_TIMEOUT = 50;	// Milliseconds to wait for each reply character while tracking
+const unsigned int LINK_RESET_BACKOFF_MIN = 1000;	// Milliseconds before retrying a failed full reset, doubling each time
+const unsigned int LINK_RESET_BACKOFF_MAX = 30000;
+
+// Steps of the link recovery state machine, in the order they are tried
+enum linkRecoveryState
+{
+	LINK_OK,		// Frames are arriving
+	LINK_RESYNC,	// Flushing the port and resynchronising on the next reply
+	LINK_REINIT,	// Leaving and re-entering tracking mode, handles untouched
+	LINK_RESET,		// Serial break, reset, COMM, INIT and reactivating the sensors
+	LINK_DOWN		// All the steps failed, tried again on the next frame with the full reset backed off
+};
+
+// Outage metrics of the serial link
+typedef struct linkMetricsStruct
+{
+	linkRecoveryState state;
+	unsigned long outages;			// Number of times the link was declared lost
+	unsigned long resyncs;			// Outages recovered by each step
+	unsigned long reinits;
+	unsigned long resets;
+	double lastOutageMs;			// From the first failed reply to the next good one
+	double longestOutageMs;
+	double totalOutageMs;
+} linkMetrics;
+
+// Cold information about a sensor, from PHINF
+typedef struct sensorMetadataStruct
+{
+	bool ready;				// False until PHINF has been read for the sensor
+	int handle;
+	std::string toolType;
+	std::string manufacturer;
+	std::string serialNumber;
+	std::string revision;
+	std::string partNumber;
+	std::string physicalPort;
+} sensorMetadata;
 
 class serialThread
 {
@@ -40,57 +111,291 @@ public:
 	// Interface commands
 	bool connectToAurora(std::string &portName, std::string &baudRate, bool hardwareHandshake);
 	bool resetAurora(std::string &portName);
-	void activateSensors();
+	void activateSensors(bool deferMetadata = false);
 	void startTracking();
 	void stopTracking();
 	int getNumOfSensors();
 
+	// Extra sensor slots to leave for tools plugged in after activation, DEFAULT_SPARE_SENSOR_SLOTS unless set.
+	// Takes effect on the next activateSensors, a tool plugged in once they are all taken isn't tracked
+	void setSpareSensorSlots(int spareSlots);
+
+	// Session persistence, lets a new process carry on with an Aurora that is still tracking
+	void setSessionFile(const std::string &sessionFile);
+	std::string getSessionFile();
+	bool resumeSession(std::string &portName);
+	void suspendTracking();
+
 	// Log file commands
 	void setLogFile(const std::string &logFile);
 	std::string getLogFile();
 
+	// The log is written in batches, and synced to the disk at most every msInterval, 0 for every batch. Set while stopped
+	void setLogSyncInterval(unsigned int msInterval);
+	void getLogStatistics(logWriterStatistics &statistics);
+	void setLogFormat(logFormat format);
+	logFormat getLogFormat();
+
 	// Retrieve sensor data for the controller
+	void getSensorData(std::vector<sensorFrame> &sensorDataStore);
+
+	// Old fixed width form, positions only, kept for existing callers. Slots past getNumOfSensors() are zeros
 	void getSensorData(std::vector<logBufferUnit> &sensorDataStore);
+
+	// Same, into caller buffers in one pass without allocating. sensors holds maxFrames * getNumOfSensors() records,
+	// frame i's records start at sensors + i * getNumOfSensors(). Returns the number of frames copied
+	size_t getSensorData(sensorFrameHeader *headers, sensorRecord *sensors, size_t maxFrames);
+
+	// Newest frame only, lock-free and independent of the backlog, retrying if a write overlaps. The wait returns false on timeout.
+	// It waits for a frame published after the one numbered sequence, start from 0, and sets sequence to the frame it returns.
+	// Frame numbers start again when the Aurora is reset, so they can't tell a new frame from an old one
+	bool getLatestSensorData(sensorFrame &latestSensorData);
+	bool waitForSensorData(boost::uint64_t &sequence, sensorFrame &latestSensorData, unsigned int msTimeout);
+
+	// Poses at the caller's own steady clock times, interpolated between frames or extrapolated a little past the newest.
+	// The array form returns a mask with bit n set if slot n has a pose
+	bool getSensorPoseAt(int slot, schedulerTime time, sensorPose &pose);
+	unsigned int getSensorPosesAt(schedulerTime time, boost::array<sensorPose, MAX_NUM_OF_SENSORS> &poses);
+
+	// Optional Kalman filter stage, off unless enabled before tracking starts. Gives the smoothed pose of the
+	// latest frame with a prediction to its delivery, or a prediction to another time shortly after it
+	void setPoseFilter(bool enable, const poseFilterSettings &settings);
+	bool getFilteredSensorPose(int slot, filteredPose &pose);
+	bool predictSensorPose(int slot, schedulerTime time, sensorPose &pose);
+
+	// Mean, variance and range of each sensor's position and error over its last window poses, read without locking.
+	// Only set the window while stopped, it clears the statistics
+	void setStatisticsWindow(unsigned int window);
+	bool getSensorStatistics(int slot, sensorStatistics &statistics);
+
+	// In-memory history of the session, off until given a budget in bytes, 0 turns it off again. Older frames are
+	// kept compressed. Queries append the frames in range oldest first and consume nothing, so it can be rewound any time.
+	// Returns false if the budget is under one chunk of HISTORY_CHUNK_FRAMES uncompressed frames
+	bool setHistoryBudget(size_t memoryBudget);
+	size_t getHistoryByFrameNumber(unsigned long firstFrame, unsigned long lastFrame, std::vector<sensorFrame> &frames);
+	size_t getHistoryByTime(schedulerTime fromTime, schedulerTime toTime, std::vector<sensorFrame> &frames);
+	void getHistoryInfo(historyInfo &info);
+
+	// Frame callbacks, inline on the thread post-processing the frame or on the dispatcher thread. A dispatcher subscription
+	// more than maxLag frames behind skips the oldest, getSubscriptionOverruns counts what it lost
+	int subscribeFrames(const frameCallback &callback, frameExecutor executor = EXECUTE_DISPATCHER, size_t maxLag = BUFFER_SIZE / 2);
+	void unsubscribeFrames(int subscription);
+
+	// Same, but only for a down-sampled stream: every factor frames, or at rateHz, as the latest, average or min/max frames.
+	// The down-sampling is done once as frames are published, so the callback runs only at its own rate
+	int subscribeDecimatedFrames(const frameCallback &callback, const frameDecimation &decimation, frameExecutor executor = EXECUTE_DISPATCHER);
+	unsigned long getSubscriptionOverruns(int subscription);
+
+	// Further readers of the frames, each sees every frame through its own cursor. Views point into the
+	// ring and must be released, release returns false if the frame was overwritten while it was read
+	int addFrameSubscriber();
+	void removeFrameSubscriber(int subscriber);
+	bool peekFrame(int subscriber, sensorFrameView &view);
+	bool releaseFrame(int subscriber);
+	size_t getSubscriberLag(int subscriber);
+	unsigned long getSubscriberOverruns(int subscriber);
+
+	// What happens when a subscriber's queue is full, and its counters to size BUFFER_SIZE from. Drop-newest and block
+	// only cost that subscriber frames, blocking holds up the publishing worker for up to msBlock. The logger and
+	// controller use overwrite-oldest unless set, change the logger's only while stopped
+	int getLoggingSubscriber();
+	int getControllerSubscriber();
+	void setSubscriberOverflowPolicy(int subscriber, overflowPolicy policy, unsigned int msBlock = 0);
+	void getSubscriberStatistics(int subscriber, queueStatistics &statistics);
+
+	// Spilling mode for the controller, frames it falls behind on past BUFFER_SIZE go to the file and are read back
+	// by getSensorData as it catches up, so none are lost. An empty name goes back to the ring. Only call while stopped
+	bool setControllerSpillFile(const std::string &spillFile);
+	void getControllerSpillStatistics(spillStatistics &statistics);
+
+	// Threads for the work done on each frame after it is read, taking effect on the next start. The tracking thread
+	// only reads and decodes, and waits if PIPELINE_DEPTH frames are still being processed. 0 does it all on the tracking thread
+	void setPostProcessingThreads(int threads);
+	void getPostProcessingStatistics(pipelineStatistics &statistics);
 	
-	// Check for broken sensors
+	// Check for broken sensors, as of the latest frame
 	bool anyBrokenSensors();
 	void getSensorsStatus(boost::array<bool, MAX_NUM_OF_SENSORS> &sensorDataValid);
 
+	// Full SENSOR_ status bits of each slot, and their transitions as they happen. None of these lock
+	void getSensorsStatus(boost::array<unsigned int, MAX_NUM_OF_SENSORS> &sensorStatus);
+	bool getSensorStatusEvent(sensorStatusEvent &event);
+	bool waitForSensorStatusEvent(sensorStatusEvent &event, unsigned int msTimeout);
+	unsigned long getDroppedSensorStatusEvents();
+
+	// Sensor metadata, may arrive after tracking has started if it was deferred
+	void getSensorMetadata(boost::array<sensorMetadata, MAX_NUM_OF_SENSORS> &metadata);
+	bool sensorMetadataReady();
+
+	// Scheduling, affinity and memory locking of the tracking and logging threads, takes effect on the next start
+	void setThreadPolicy(const threadPolicy &policy);
+	void getAppliedThreadPolicy(appliedThreadPolicy &applied);
+
+	// Time BX requests to the Aurora's frame rate, duplicate frames are dropped either way
+	void setPhaseLockedScheduling(bool phaseLocked);
+	double getFramePeriodMs();
+	unsigned long getDuplicateFrames();
+
+	// Fit of the device frame clock to the host clock, used to time stamp every frame
+	void getClockSyncState(clockSyncState &state);
+
+	// Link recovery
+	void setLinkTimeout(unsigned int msTimeout);
+	void getLinkMetrics(linkMetrics &metrics);
+
 protected:
 	void stop();
+	void stopLogging();
+	void waitForNextRequest();
+	bool getReplyFrameNumber(unsigned long &frameNumber);
+	void notifyLogging();
+	void stopDispatcher();
+	void notifyDispatcher();
+	void runDispatcher();
+	void startThreads();
+	void stopThreads();
 	void runTracking();
 	void writeSensorDataToLogFile();
 
 private:
-	volatile bool stopTrackingFlag;
-	volatile bool stopLoggingFlag;
+	boost::atomic<bool> stopTrackingFlag;
+	boost::atomic<bool> stopLoggingFlag;
+	boost::atomic<bool> stopDispatcherFlag;
 	void connectToCOMPort();
 	void setCurrentSensorData();
+	void publishFrame(pipelineFrame &frame);
+	void spillFrame(pipelineFrame &frame);
+	void trackPoses(pipelineFrame &frame);
+	void updateStatistics(pipelineFrame &frame);
+	void deliverFrame(pipelineFrame &frame);
+	void updateSensorHandles();
 
 	void setNumOfSensors();
+	void configureSensorSlots(int slots);
+	void assignSensorSlots();
+
+	bool linkFailed();
+	bool recoverLink();
+	void linkRestored();
+	void setLinkState(linkRecoveryState state);
+
+	// Saving writes the file here, queueing hands the write to the logging thread so the tracking thread never waits on the disk
+	void saveSession();
+	void queueSessionSave();
+	void formatSession(std::string &session);
+	void writeSessionFile(const std::string &session);
+
+	void applyThreadPolicy(threadScheduling scheduling, int priority, int cpu, bool &schedulingApplied, bool &affinityApplied);
+	void prefaultBuffers();
+
+	void fetchSensorMetadata();
+	void publishSensorMetadata(int slot);
+	unsigned long describeSensors(std::vector<sessionLogSensor> &sensors);
+	void logSensorChanges(std::vector<sessionLogSensor> &loggedSensors, unsigned long &loggedChanges);
 	CCommandHandling SerialCommands;
 	serialCommunicator SerialPort;
-	int numSensors;
+	int numSensors;			// Sensor slots in every frame, fixed at activation
+	int spareSensorSlots;
 	std::string logFileName;
+	logWriter LogFile;				// Only the logging thread writes it
+	sessionLogWriter SessionLog;	// Binary format, through LogFile
+	unsigned int logSyncIntervalMs;
+	logFormat logFileFormat;
+	std::string sessionFileName;
+	std::string pendingSession;			// Latest session queued for the logging thread
+	boost::atomic<bool> sessionSavePending;
+	boost::mutex sessionMutex;
+	bool trackingSuspended;
+
+	// Connection settings, kept so the link can be brought back after a full reset
+	std::string comPortName;
+	std::string comBaudRate;
+	bool comHardwareHandshake;
+
+	threadPolicy requestedThreadPolicy;
+	appliedThreadPolicy currentThreadPolicy;
+
+	frameScheduler bxScheduler;
+	bool phaseLockedScheduling;
+
+	clockSync frameClock;
+	schedulerTime currentAcquisitionTime;	// Of the frame being filled in
+
+	unsigned int linkTimeoutMs;
+	int consecutiveLinkFailures;
+	boost::chrono::steady_clock::time_point outageStart;
+	unsigned int resetBackoffMs;	// 0 until a full reset fails
+	boost::chrono::steady_clock::time_point nextResetTime;
+	linkMetrics currentLinkMetrics;
 
 	unsigned long currentFrameNumber;
 
-	volatile bool brokenSensors;
-	boost::array<bool, MAX_NUM_OF_SENSORS> sensorsValid;
-	//Position3d currentSensorData[MAX_NUM_OF_SENSORS];
+	// Port handle held by each sensor slot, -1 if the slot is vacant.
+	// Slots are kept stable so hot-plugging a tool doesn't move the other sensors' data.
+	boost::array<int, MAX_NUM_OF_SENSORS> sensorSlotHandles;
+
+	// PHINF is fetched between frames once tracking has started
+	bool deferSensorMetadata;
+	boost::array<sensorMetadata, MAX_NUM_OF_SENSORS> sensorsMetadata;
+	boost::atomic<unsigned long> sensorMetadataChanges;		// Publishes so far, under sensorMetadataMutex
+
+	// Status of each slot, published by the tracking thread without locking
+	sensorHealth SensorHealth;
+
+	// Frame being filled by the tracking thread, sized at activation so it never allocates
+	std::vector<sensorRecord> currentSensorData;
 
-	//logBufferUnit currentSensorDataLog;
+	// Tracking thread waits on this between phase-locked requests, stop wakes it
+	boost::mutex trackingMutex;
+	boost::condition_variable trackingCondition;
 
-	boost::mutex stopTrackMutex;
-	boost::mutex stopLogMutex;
-	boost::mutex sensorStatusMutex;
+	// Logging thread waits on this for data instead of polling
+	boost::mutex loggingMutex;
+	boost::condition_variable loggingCondition;
+
+	// Dispatcher thread waits on this for frames for its callbacks
+	boost::mutex dispatcherMutex;
+	boost::condition_variable dispatcherCondition;
+	boost::mutex linkMetricsMutex;
+	boost::mutex sensorMetadataMutex;
+	boost::mutex threadPolicyMutex;
 	//boost::mutex serialMutex;	// Shouldn't need this, should disable sending commands when tracking
 
 	// Threads
 	boost::thread TrackingThread;
 	boost::thread LoggingThread;
+	boost::thread DispatcherThread;
 	
-	// Data Buffers - these are circular(rings) buffers
-	boost::lockfree::spsc_queue<logBufferUnit, boost::lockfree::capacity<LOG_BUFFER_SIZE>> LoggingCircularBuffer;
-	boost::lockfree::spsc_queue<logBufferUnit, boost::lockfree::capacity<BUFFER_SIZE>> ControllerCircularBuffer;
+	// Data Buffer - one ring written once per frame, the logger and the controller read it through their own cursors
+	broadcastRing FrameBuffer;
+	int loggingSubscriber;
+	int controllerSubscriber;
+
+	// Newest frame, overwritten every frame for readers that don't want the backlog
+	latestFrame LatestSensorData;
+
+	// Last few frames of every sensor for pose queries at any time
+	poseInterpolator PoseHistory;
+
+	// Sliding window statistics of every sensor
+	windowedStatistics SensorStatistics;
+
+	// Filter stage, only run if enabled
+	poseFilter PoseFilter;
+	bool poseFiltering;
+
+	// Rewindable history, filled on the dispatcher thread through its own subscription
+	frameHistory History;
+	int historySubscription;
+
+	// Controller queue in spilling mode, filled by its own post-processing stage
+	spillQueue ControllerSpill;
+	bool controllerSpilling;
+
+	// Callbacks, dispatcher subscriptions read FrameBuffer so it must be declared first
+	frameDispatcher FrameDispatcher;
+
+	// Stages after decoding, publishFrame, spillFrame, trackPoses, updateStatistics then deliverFrame. Last, as its threads use all the above
+	framePipeline PostProcessing;
+	int postProcessingThreads;
 };
\ No newline at end of file
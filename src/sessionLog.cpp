@@ -0,0 +1,142 @@
+#include "sessionLog.h"
+#include <iostream>
+#include <cstring>
+
+void setSessionLogString(char *field, const std::string &value)
+{
+	// Always leaves a terminating zero
+	std::memset(field, 0, SESSION_LOG_STRING);
+	value.copy(field, SESSION_LOG_STRING - 1);
+}
+
+size_t sessionLogChangeRecords(int numSensors)
+{
+	size_t partBytes = numSensors * sizeof(sensorRecord);
+
+	return partBytes > 0 ? ( sizeof(sessionLogSensor) + partBytes - 1 ) / partBytes : 0;
+}
+
+sessionLogWriter::sessionLogWriter(logWriter &file) : file(file)
+{
+	numSensors = 0;
+	records = 0;
+	begun = false;
+}
+
+bool sessionLogWriter::begin(const std::vector<sessionLogSensor> &sensors, boost::int64_t startTime, boost::int64_t startWallTime)
+{
+	// Offsets in the file are absolute, so it has to start empty
+	if( !file.isOpen() || file.getPosition() != 0 )
+	{
+		std::cout << "Session log file must be open and empty!" << std::endl;
+		return false;
+	}
+
+	numSensors = int(sensors.size());
+	records = 0;
+	index.clear();
+	sensorChanges.clear();
+	std::memset(&lastFrame, 0, sizeof(lastFrame));
+
+	sessionLogHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, SESSION_LOG_MAGIC, sizeof(header.magic));
+	header.version = SESSION_LOG_VERSION;
+	header.headerBytes = boost::uint32_t( sizeof(sessionLogHeader) + numSensors * sizeof(sessionLogSensor) );
+	header.numSensors = numSensors;
+	header.recordBytes = boost::uint32_t( sizeof(sessionLogRecord) + numSensors * sizeof(sensorRecord) );
+	header.indexInterval = SESSION_LOG_INDEX_INTERVAL;
+	header.startTime = startTime;
+	header.startWallTime = startWallTime;
+
+	begun = file.write(&header, sizeof(header));
+	if( begun && numSensors > 0 ) begun = file.write(&sensors[0], numSensors * sizeof(sessionLogSensor));
+
+	return begun;
+}
+
+bool sessionLogWriter::writeFrames(const sensorFrameHeader *headers, const sensorRecord *sensors, size_t count)
+{
+	if( !begun ) return false;
+
+	for( size_t n = 0; n != count; ++n )
+	{
+		sessionLogRecord record;
+		record.frameNumber = headers[n].frameNumber;
+		record.acquisitionTime = headers[n].acquisitionTime;
+		record.systemStatus = headers[n].systemStatus;
+		record.numSensors = boost::uint16_t( numSensors );
+		record.type = SESSION_LOG_FRAME;
+
+		if( !writeRecord(record, sensors + n * numSensors) ) return false;
+		lastFrame = record;
+	}
+
+	return true;
+}
+
+bool sessionLogWriter::writeSensor(const sessionLogSensor &sensor)
+{
+	size_t parts = sessionLogChangeRecords(numSensors);
+	if( !begun || parts == 0 ) return false;
+
+	// Cut into parts the size of a frame's sensors, the last one zero padded
+	size_t partBytes = numSensors * sizeof(sensorRecord);
+	std::vector<unsigned char> payload(parts * partBytes, 0);
+	std::memcpy(&payload[0], &sensor, sizeof(sensor));
+
+	// Ordered with the frame before, so searches pass over it
+	sessionLogRecord record = lastFrame;
+	record.numSensors = boost::uint16_t( numSensors );
+	record.type = SESSION_LOG_SENSOR_CHANGE;
+
+	sensorChanges.push_back(records);
+
+	for( size_t part = 0; part != parts; ++part )
+	{
+		record.systemStatus = boost::uint32_t( part );
+		if( !writeRecord(record, &payload[part * partBytes]) ) return false;
+	}
+
+	return true;
+}
+
+bool sessionLogWriter::writeRecord(const sessionLogRecord &record, const void *payload)
+{
+	if( records % SESSION_LOG_INDEX_INTERVAL == 0 )
+	{
+		sessionLogIndexEntry entry = { records, record.frameNumber, record.acquisitionTime };
+		index.push_back(entry);
+	}
+
+	if( !file.write(&record, sizeof(record)) ) return false;
+	if( numSensors > 0 && !file.write(payload, numSensors * sizeof(sensorRecord)) ) return false;
+
+	++records;
+	return true;
+}
+
+bool sessionLogWriter::end()
+{
+	if( !begun ) return false;
+	begun = false;
+
+	sessionLogFooter footer;
+	footer.indexOffset = file.getPosition();
+	footer.indexEntries = index.size();
+	footer.sensorChanges = sensorChanges.size();
+	footer.records = records;
+	std::memcpy(footer.magic, SESSION_LOG_INDEX_MAGIC, sizeof(footer.magic));
+
+	bool written = true;
+	if( !index.empty() ) written = file.write(&index[0], index.size() * sizeof(sessionLogIndexEntry));
+	if( !sensorChanges.empty() ) written = written && file.write(&sensorChanges[0], sensorChanges.size() * sizeof(boost::uint64_t));
+	written = written && file.write(&footer, sizeof(footer));
+
+	return file.commit() && written;
+}
+
+boost::uint64_t sessionLogWriter::getRecords() const
+{
+	return records;
+}
@@ -0,0 +1,142 @@
+/*
+	Binary session log.  The file starts with a header describing the
+	session and each sensor slot, followed by one fixed size record per
+	frame, so record n is at a known offset.  When a slot's description
+	changes, a tool plugged in or its PHINF read late, the new one goes
+	in among the frames as a sensor change: a run of records of the
+	same size, each carrying the next part of it.  Every record starts
+	with the frame number and time of the frame before it, so the
+	records stay in order for searching.  When the session ends a
+	sparse index of every SESSION_LOG_INDEX_INTERVAL'th record's frame
+	number and time is written after the records, then where each
+	sensor change starts, with a footer at the very end saying where
+	they are.  A log cut short has no footer, but its records are still
+	readable.  Everything is in the host byte order, little endian on
+	every platform the library runs on.
+*/
+
+#include "sensorFrame.h"
+#include "logWriter.h"
+#include <boost/static_assert.hpp>
+#include <boost/cstdint.hpp>
+#include <string>
+#include <vector>
+
+#pragma once
+
+// Session log constants
+const char SESSION_LOG_MAGIC[8] = { 'A', 'U', 'R', 'L', 'O', 'G', '0', '1' };
+const char SESSION_LOG_INDEX_MAGIC[8] = { 'A', 'U', 'R', 'I', 'D', 'X', '0', '1' };
+const boost::uint32_t SESSION_LOG_VERSION = 2;
+const boost::uint32_t SESSION_LOG_INDEX_INTERVAL = 64;	// Records between index entries
+const int SESSION_LOG_STRING = 32;						// Bytes for each PHINF string, zero padded
+
+// What a record holds
+enum sessionLogRecordType
+{
+	SESSION_LOG_FRAME,			// A frame, numSensors sensorRecords
+	SESSION_LOG_SENSOR_CHANGE	// Part systemStatus of a sessionLogSensor, in the space the sensorRecords would take
+};
+
+// Start of the file
+typedef struct sessionLogHeaderStruct
+{
+	char magic[8];					// SESSION_LOG_MAGIC
+	boost::uint32_t version;
+	boost::uint32_t headerBytes;	// This header and the sensor descriptions, the records start here
+	boost::uint32_t numSensors;
+	boost::uint32_t recordBytes;
+	boost::uint32_t indexInterval;
+	boost::uint32_t reserved;
+	boost::int64_t startTime;		// Steady clock nanoseconds, the clock the frames' acquisition times are on
+	boost::int64_t startWallTime;	// Microseconds since 1970 UTC at the same instant
+} sessionLogHeader;
+
+// One per sensor slot, after the header
+typedef struct sessionLogSensorStruct
+{
+	boost::int32_t slot;
+	boost::int32_t handle;			// -1 for a vacant slot
+	boost::uint32_t ready;			// 0 if PHINF hadn't been read yet, the strings are then empty
+	boost::uint32_t reserved;
+	char toolType[SESSION_LOG_STRING];
+	char manufacturer[SESSION_LOG_STRING];
+	char serialNumber[SESSION_LOG_STRING];
+	char revision[SESSION_LOG_STRING];
+	char partNumber[SESSION_LOG_STRING];
+	char physicalPort[SESSION_LOG_STRING];
+} sessionLogSensor;
+
+// Front of each record, followed by numSensors sensorRecords or part of a sensor change
+typedef struct sessionLogRecordStruct
+{
+	boost::uint64_t frameNumber;	// A sensor change has the frame number and time of the frame before it, 0 before the first
+	boost::int64_t acquisitionTime;	// Steady clock nanoseconds
+	boost::uint32_t systemStatus;	// Part number of a sensor change
+	boost::uint16_t numSensors;
+	boost::uint16_t type;			// sessionLogRecordType
+} sessionLogRecord;
+
+// Sparse index, one entry for every indexInterval records
+typedef struct sessionLogIndexEntryStruct
+{
+	boost::uint64_t record;
+	boost::uint64_t frameNumber;
+	boost::int64_t acquisitionTime;
+} sessionLogIndexEntry;
+
+// Very end of a complete file
+typedef struct sessionLogFooterStruct
+{
+	boost::uint64_t indexOffset;	// From the start of the file
+	boost::uint64_t indexEntries;
+	boost::uint64_t sensorChanges;	// Record numbers where each sensor change starts, 8 bytes each after the index
+	boost::uint64_t records;
+	char magic[8];					// SESSION_LOG_INDEX_MAGIC
+} sessionLogFooter;
+
+// No padding anywhere, the layout is the same for every compiler
+BOOST_STATIC_ASSERT(sizeof(sessionLogHeader) == 48);
+BOOST_STATIC_ASSERT(sizeof(sessionLogSensor) == 16 + 6 * SESSION_LOG_STRING);
+BOOST_STATIC_ASSERT(sizeof(sessionLogRecord) == 24);
+BOOST_STATIC_ASSERT(sizeof(sessionLogIndexEntry) == 24);
+BOOST_STATIC_ASSERT(sizeof(sessionLogFooter) == 40);
+
+// Copy a string into a zero padded field, cutting it short if need be
+void setSessionLogString(char *field, const std::string &value);
+
+// Records a sensor change takes in a log with numSensors slots, 0 if there is no room for one
+size_t sessionLogChangeRecords(int numSensors);
+
+class sessionLogWriter
+{
+
+public:
+	// Writes through file, which must be open and empty when the log begins
+	explicit sessionLogWriter(logWriter &file);
+
+	// The header, sensors has one entry per slot
+	bool begin(const std::vector<sessionLogSensor> &sensors, boost::int64_t startTime, boost::int64_t startWallTime);
+
+	// Records go into the file's buffer, commit the file to write them out
+	bool writeFrames(const sensorFrameHeader *headers, const sensorRecord *sensors, size_t count);
+
+	// New description of sensor.slot, taking effect from the next frame written
+	bool writeSensor(const sessionLogSensor &sensor);
+
+	// The index and the footer. The file is left open
+	bool end();
+
+	boost::uint64_t getRecords() const;
+
+private:
+	bool writeRecord(const sessionLogRecord &record, const void *payload);
+
+	logWriter &file;
+	int numSensors;
+	boost::uint64_t records;
+	bool begun;
+	sessionLogRecord lastFrame;						// Keys for sensor changes
+	std::vector<sessionLogIndexEntry> index;
+	std::vector<boost::uint64_t> sensorChanges;
+};
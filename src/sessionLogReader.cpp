@@ -0,0 +1,245 @@
+#include "sessionLogReader.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+sessionLogReader::sessionLogReader()
+{
+	base = NULL;
+	size = 0;
+	header = NULL;
+	index = NULL;
+	indexEntries = 0;
+	records = 0;
+}
+
+bool sessionLogReader::open(const std::string &fileName)
+{
+	close();
+
+	try
+	{
+		boost::interprocess::file_mapping mapping(fileName.c_str(), boost::interprocess::read_only);
+		boost::interprocess::mapped_region mapped(mapping, boost::interprocess::read_only);
+		file.swap(mapping);
+		region.swap(mapped);
+	}
+	catch( boost::interprocess::interprocess_exception &e )
+	{
+		std::cout << "Couldn't map the session log " << fileName << ": " << e.what() << std::endl;
+		return false;
+	}
+
+	base = static_cast<const unsigned char *>(region.get_address());
+	size = region.get_size();
+
+	// Check the header before trusting any of its sizes
+	header = reinterpret_cast<const sessionLogHeader *>(base);
+	if( size < sizeof(sessionLogHeader) || std::memcmp(header->magic, SESSION_LOG_MAGIC, sizeof(header->magic)) != 0 ||
+		header->version != SESSION_LOG_VERSION || header->numSensors > MAX_NUM_OF_SENSORS ||
+		header->headerBytes != sizeof(sessionLogHeader) + header->numSensors * sizeof(sessionLogSensor) ||
+		header->recordBytes != sizeof(sessionLogRecord) + header->numSensors * sizeof(sensorRecord) ||
+		size < header->headerBytes )
+	{
+		std::cout << fileName << " is not a session log!" << std::endl;
+		close();
+		return false;
+	}
+
+	// Take the index if the footer is there and agrees with the file, otherwise count the whole records
+	records = ( size - header->headerBytes ) / header->recordBytes;
+	bool complete = false;
+
+	if( size >= header->headerBytes + sizeof(sessionLogFooter) )
+	{
+		const sessionLogFooter *footer = reinterpret_cast<const sessionLogFooter *>(base + size - sizeof(sessionLogFooter));
+
+		if( std::memcmp(footer->magic, SESSION_LOG_INDEX_MAGIC, sizeof(footer->magic)) == 0 &&
+			footer->indexOffset == header->headerBytes + footer->records * header->recordBytes &&
+			footer->indexOffset + footer->indexEntries * sizeof(sessionLogIndexEntry) + footer->sensorChanges * sizeof(boost::uint64_t) +
+				sizeof(sessionLogFooter) == size )
+		{
+			records = footer->records;
+			indexEntries = footer->indexEntries;
+			index = indexEntries > 0 ? reinterpret_cast<const sessionLogIndexEntry *>(base + footer->indexOffset) : NULL;
+
+			const boost::uint64_t *changes = reinterpret_cast<const boost::uint64_t *>(base + footer->indexOffset + indexEntries * sizeof(sessionLogIndexEntry));
+			sensorChanges.assign(changes, changes + footer->sensorChanges);
+			complete = true;
+		}
+	}
+
+	// No list of the sensor changes, look at every record for them
+	if( !complete )
+	{
+		for( boost::uint64_t n = 0; n != records; ++n )
+		{
+			const sessionLogRecord *at = recordAt(n);
+			if( at->type == SESSION_LOG_SENSOR_CHANGE && at->systemStatus == 0 ) sensorChanges.push_back(n);
+		}
+	}
+
+	return true;
+}
+
+void sessionLogReader::close()
+{
+	boost::interprocess::mapped_region emptyRegion;
+	region.swap(emptyRegion);
+
+	boost::interprocess::file_mapping emptyFile;
+	file.swap(emptyFile);
+
+	base = NULL;
+	size = 0;
+	header = NULL;
+	index = NULL;
+	indexEntries = 0;
+	records = 0;
+	sensorChanges.clear();
+}
+
+bool sessionLogReader::isOpen() const
+{
+	return header != NULL;
+}
+
+const sessionLogHeader &sessionLogReader::getHeader() const
+{
+	return *header;
+}
+
+const sessionLogSensor *sessionLogReader::getSensors() const
+{
+	return reinterpret_cast<const sessionLogSensor *>(base + sizeof(sessionLogHeader));
+}
+
+boost::uint64_t sessionLogReader::getRecordCount() const
+{
+	return records;
+}
+
+bool sessionLogReader::hasIndex() const
+{
+	return index != NULL;
+}
+
+bool sessionLogReader::getRecord(boost::uint64_t record, sessionLogView &view) const
+{
+	if( record >= records ) return false;
+
+	const unsigned char *at = base + header->headerBytes + record * header->recordBytes;
+	view.record = reinterpret_cast<const sessionLogRecord *>(at);
+	view.sensors = reinterpret_cast<const sensorRecord *>(at + sizeof(sessionLogRecord));
+	return true;
+}
+
+const sessionLogRecord *sessionLogReader::recordAt(boost::uint64_t record) const
+{
+	return reinterpret_cast<const sessionLogRecord *>(base + header->headerBytes + record * header->recordBytes);
+}
+
+boost::int64_t sessionLogReader::recordKey(boost::uint64_t record, bool byTime) const
+{
+	const sessionLogRecord *at = recordAt(record);
+	return byTime ? at->acquisitionTime : boost::int64_t( at->frameNumber );
+}
+
+boost::uint64_t sessionLogReader::nextFrame(boost::uint64_t record) const
+{
+	// A sensor change has the keys of the frame before, so the search only stops on one ahead of the first frame
+	while( record < records && recordAt(record)->type != SESSION_LOG_FRAME ) ++record;
+	return record;
+}
+
+boost::uint64_t sessionLogReader::lowerBound(bool byTime, boost::int64_t key) const
+{
+	boost::uint64_t first = 0;
+	boost::uint64_t last = records;
+
+	// Narrow to the block between two index entries first, the index is small and likely all in one page
+	if( index != NULL )
+	{
+		boost::uint64_t low = 0, high = indexEntries;
+		while( low < high )
+		{
+			boost::uint64_t middle = low + ( high - low ) / 2;
+			boost::int64_t entryKey = byTime ? index[middle].acquisitionTime : boost::int64_t( index[middle].frameNumber );
+
+			if( entryKey < key ) low = middle + 1;
+			else high = middle;
+		}
+
+		// The answer is after the entry before and no later than the entry found
+		if( low > 0 ) first = index[low - 1].record;
+		if( low < indexEntries ) last = index[low].record;
+	}
+
+	while( first < last )
+	{
+		boost::uint64_t middle = first + ( last - first ) / 2;
+
+		if( recordKey(middle, byTime) < key ) first = middle + 1;
+		else last = middle;
+	}
+
+	return first;
+}
+
+boost::uint64_t sessionLogReader::findFrameNumber(boost::uint64_t frameNumber) const
+{
+	if( !isOpen() ) return 0;
+	return nextFrame(lowerBound(false, boost::int64_t( frameNumber )));
+}
+
+boost::uint64_t sessionLogReader::findTime(boost::int64_t time) const
+{
+	if( !isOpen() ) return 0;
+	return nextFrame(lowerBound(true, time));
+}
+
+const std::vector<boost::uint64_t> &sessionLogReader::getSensorChanges() const
+{
+	return sensorChanges;
+}
+
+bool sessionLogReader::getSensorChange(size_t change, sessionLogSensor &sensor) const
+{
+	if( change >= sensorChanges.size() ) return false;
+
+	boost::uint64_t first = sensorChanges[change];
+	size_t parts = sessionLogChangeRecords(header->numSensors);
+	size_t partBytes = header->numSensors * sizeof(sensorRecord);
+	if( parts == 0 || first + parts > records ) return false;
+
+	// Put the parts back together, the last one may be cut short
+	unsigned char *bytes = reinterpret_cast<unsigned char *>(&sensor);
+
+	for( size_t part = 0; part != parts; ++part )
+	{
+		const sessionLogRecord *at = recordAt(first + part);
+		if( at->type != SESSION_LOG_SENSOR_CHANGE || at->systemStatus != part ) return false;
+
+		size_t offset = part * partBytes;
+		std::memcpy(bytes + offset, at + 1, std::min(partBytes, sizeof(sessionLogSensor) - offset));
+	}
+
+	return true;
+}
+
+void sessionLogReader::getSensorsAt(boost::uint64_t record, std::vector<sessionLogSensor> &sensors) const
+{
+	if( !isOpen() )
+	{
+		sensors.clear();
+		return;
+	}
+
+	sensors.assign(getSensors(), getSensors() + header->numSensors);
+
+	for( size_t change = 0; change != sensorChanges.size() && sensorChanges[change] < record; ++change )
+	{
+		sessionLogSensor sensor;
+		if( getSensorChange(change, sensor) && sensor.slot >= 0 && sensor.slot < boost::int32_t( header->numSensors ) ) sensors[sensor.slot] = sensor;
+	}
+}
@@ -0,0 +1,76 @@
+/*
+	Reader for the binary session logs.  The whole file is memory
+	mapped, so records are read in place without copying.  Seeking by
+	frame number or time is a binary search: over the sparse index to
+	find the block, then over the block's records.  A log without an
+	index, one cut short, is searched over its records directly.  Either
+	way it takes O(log n) record reads.  Frame numbers are assumed to
+	increase, as they do unless the Aurora is reset mid session; the
+	acquisition times always do.  Sensor changes are found from the
+	list at the end of the file, or by reading every record's type in a
+	log cut short, and applied to the header's sensors on request.
+*/
+
+#include "sessionLog.h"
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/cstdint.hpp>
+#include <string>
+#include <vector>
+
+#pragma once
+
+// A record in the mapped file, valid until the reader is closed
+typedef struct sessionLogViewStruct
+{
+	const sessionLogRecord *record;
+	const sensorRecord *sensors;	// record->numSensors records
+} sessionLogView;
+
+class sessionLogReader
+{
+
+public:
+	sessionLogReader();
+
+	bool open(const std::string &fileName);
+	void close();
+	bool isOpen() const;
+
+	const sessionLogHeader &getHeader() const;
+	const sessionLogSensor *getSensors() const;		// header.numSensors of them
+	boost::uint64_t getRecordCount() const;
+	bool hasIndex() const;
+
+	// Record n, without copying. Frames have record->type SESSION_LOG_FRAME, skip the others when iterating
+	bool getRecord(boost::uint64_t record, sessionLogView &view) const;
+
+	// First frame at or after the frame number or the steady clock time, getRecordCount() if there is none.
+	// Iterate on from there with getRecord
+	boost::uint64_t findFrameNumber(boost::uint64_t frameNumber) const;
+	boost::uint64_t findTime(boost::int64_t time) const;
+
+	// Records where each sensor change starts, in order, and the description each one gives its slot
+	const std::vector<boost::uint64_t> &getSensorChanges() const;
+	bool getSensorChange(size_t change, sessionLogSensor &sensor) const;
+
+	// Every slot as it was at a record: the header's sensors with the changes before the record applied
+	void getSensorsAt(boost::uint64_t record, std::vector<sessionLogSensor> &sensors) const;
+
+private:
+	const sessionLogRecord *recordAt(boost::uint64_t record) const;
+	boost::uint64_t nextFrame(boost::uint64_t record) const;
+	boost::uint64_t lowerBound(bool byTime, boost::int64_t key) const;
+	boost::int64_t recordKey(boost::uint64_t record, bool byTime) const;
+
+	boost::interprocess::file_mapping file;
+	boost::interprocess::mapped_region region;
+	const unsigned char *base;
+	boost::uint64_t size;
+
+	const sessionLogHeader *header;
+	const sessionLogIndexEntry *index;
+	boost::uint64_t indexEntries;
+	boost::uint64_t records;
+	std::vector<boost::uint64_t> sensorChanges;
+};
@@ -0,0 +1,274 @@
+#include "spillQueue.h"
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+
+static const size_t NO_SEGMENT = size_t(-1);
+
+spillQueue::spillQueue(size_t memoryFrames) : memory(memoryFrames)
+{
+	writeRegionSegment = NO_SEGMENT;
+	readRegionSegment = NO_SEGMENT;
+	fileSegments = 0;
+	configure(0);
+}
+
+spillQueue::~spillQueue()
+{
+	close();
+}
+
+bool spillQueue::open(const std::string &spillFile)
+{
+	close();
+
+	boost::lock_guard<boost::mutex> lock(spillMutex);
+
+	// Start from an empty file, it grows a segment at a time
+	std::ofstream create(spillFile.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if( !create.is_open() )
+	{
+		std::cout << "Couldn't create the spill file " << spillFile << "!" << std::endl;
+		return false;
+	}
+	create.close();
+
+	try
+	{
+		boost::interprocess::file_mapping mapping(spillFile.c_str(), boost::interprocess::read_write);
+		file.swap(mapping);
+	}
+	catch( boost::interprocess::interprocess_exception &e )
+	{
+		std::cout << "Couldn't map the spill file " << spillFile << ": " << e.what() << std::endl;
+		return false;
+	}
+
+	fileName = spillFile;
+	fileSegments = 0;
+	return true;
+}
+
+void spillQueue::close()
+{
+	boost::lock_guard<boost::mutex> lock(spillMutex);
+
+	// Everything still queued is dropped with the file, in memory as well, and counted as lost
+	lostFrames += (unsigned long)( spilledFrames + memory.trimLag(0) );
+	spilledFrames = 0;
+	spilledSegments.clear();
+	freeSegments.clear();
+	fileSegments = 0;
+
+	// Unmapped and closed before the file can be deleted
+	{
+		boost::interprocess::mapped_region emptyWrite, emptyRead;
+		writeRegion.swap(emptyWrite);
+		readRegion.swap(emptyRead);
+
+		boost::interprocess::file_mapping emptyFile;
+		file.swap(emptyFile);
+	}
+	writeRegionSegment = NO_SEGMENT;
+	readRegionSegment = NO_SEGMENT;
+
+	if( !fileName.empty() ) std::remove(fileName.c_str());
+	fileName.clear();
+}
+
+bool spillQueue::isOpen() const
+{
+	boost::lock_guard<boost::mutex> lock(spillMutex);
+	return !fileName.empty();
+}
+
+void spillQueue::configure(int numSensors)
+{
+	boost::lock_guard<boost::mutex> lock(spillMutex);
+
+	this->numSensors = numSensors;
+	memory.configure(numSensors);
+	bulkFrame.resize(numSensors);
+
+	// Same layout as the memory ring, header then the records rounded up to whole words
+	slotBytes = sizeof(sensorFrameHeader) + numSensors * sizeof(sensorRecord);
+	slotBytes = ( slotBytes + sizeof(boost::uint64_t) - 1 ) / sizeof(boost::uint64_t) * sizeof(boost::uint64_t);
+	segmentBytes = slotBytes * SPILL_SEGMENT_FRAMES;
+
+	// The segment size may have changed, so the file is laid out again from the start
+	boost::interprocess::mapped_region emptyWrite, emptyRead;
+	writeRegion.swap(emptyWrite);
+	readRegion.swap(emptyRead);
+	writeRegionSegment = NO_SEGMENT;
+	readRegionSegment = NO_SEGMENT;
+
+	spilledSegments.clear();
+	freeSegments.clear();
+	fileSegments = 0;
+	writeOffset = 0;
+	readOffset = 0;
+	spilledFrames = 0;
+	totalSpilled = 0;
+	lostFrames = 0;
+}
+
+bool spillQueue::growFile(size_t segments)
+{
+	// Writing the last byte extends the file, the rest reads as zeros
+	std::filebuf extend;
+	if( !extend.open(fileName.c_str(), std::ios::in | std::ios::out | std::ios::binary) ) return false;
+
+	std::streamoff size = std::streamoff( segments ) * std::streamoff( segmentBytes );
+	bool grown = ( extend.pubseekoff(size - 1, std::ios::beg) == std::streampos(size - 1) ) && ( extend.sputc(0) == 0 );
+
+	extend.close();
+	return grown;
+}
+
+bool spillQueue::mapSegment(boost::interprocess::mapped_region &region, size_t &regionSegment, size_t segment)
+{
+	if( regionSegment == segment ) return true;
+
+	try
+	{
+		boost::interprocess::mapped_region mapping(file, boost::interprocess::read_write,
+			boost::interprocess::offset_t( segment ) * boost::interprocess::offset_t( segmentBytes ), segmentBytes);
+		region.swap(mapping);
+		regionSegment = segment;
+	}
+	catch( boost::interprocess::interprocess_exception &e )
+	{
+		std::cout << "Couldn't map segment " << segment << " of the spill file: " << e.what() << std::endl;
+		regionSegment = NO_SEGMENT;
+		return false;
+	}
+
+	return true;
+}
+
+bool spillQueue::startSegment()
+{
+	size_t segment;
+
+	// Reuse a segment the consumer has finished with before growing the file
+	if( !freeSegments.empty() )
+	{
+		segment = freeSegments.back();
+		freeSegments.pop_back();
+	}
+	else
+	{
+		segment = fileSegments;
+		if( !growFile(fileSegments + 1) )
+		{
+			std::cout << "Couldn't grow the spill file " << fileName << "!" << std::endl;
+			return false;
+		}
+		++fileSegments;
+	}
+
+	if( !mapSegment(writeRegion, writeRegionSegment, segment) )
+	{
+		freeSegments.push_back(segment);
+		return false;
+	}
+
+	if( spilledSegments.empty() ) readOffset = 0;
+	spilledSegments.push_back(segment);
+	writeOffset = 0;
+	return true;
+}
+
+bool spillQueue::push(const sensorFrameView &view)
+{
+	boost::lock_guard<boost::mutex> lock(spillMutex);
+
+	// Memory first, but only while nothing is waiting in the file or the order would be lost
+	if( spilledFrames == 0 && memory.push(*view.header, view.sensors) ) return true;
+
+	if( fileName.empty() || ( ( spilledSegments.empty() || writeOffset == SPILL_SEGMENT_FRAMES ) && !startSegment() ) )
+	{
+		++lostFrames;
+		return false;
+	}
+
+	unsigned char *slot = static_cast<unsigned char *>(writeRegion.get_address()) + writeOffset * slotBytes;
+	sensorFrameHeader *slotHeader = reinterpret_cast<sensorFrameHeader *>(slot);
+	*slotHeader = *view.header;
+	slotHeader->numSensors = numSensors;
+	if( numSensors > 0 ) std::memcpy(slotHeader + 1, view.sensors, numSensors * sizeof(sensorRecord));
+
+	++writeOffset;
+	++spilledFrames;
+	++totalSpilled;
+	return true;
+}
+
+bool spillQueue::popFrame(sensorFrame &frame)
+{
+	// Memory holds the oldest frames, the file only fills once memory is full
+	if( memory.pop(frame) ) return true;
+
+	if( spilledFrames == 0 ) return false;
+
+	if( !mapSegment(readRegion, readRegionSegment, spilledSegments.front()) ) return false;
+
+	const unsigned char *slot = static_cast<const unsigned char *>(readRegion.get_address()) + readOffset * slotBytes;
+	const sensorFrameHeader *slotHeader = reinterpret_cast<const sensorFrameHeader *>(slot);
+	frame.header = *slotHeader;
+	frame.resize(numSensors);
+	if( numSensors > 0 ) std::memcpy(&frame.sensors[0], slotHeader + 1, numSensors * sizeof(sensorRecord));
+
+	++readOffset;
+	--spilledFrames;
+
+	// Caught up with the producer, or finished a segment it has moved on from
+	if( spilledFrames == 0 )
+	{
+		freeSegments.insert(freeSegments.end(), spilledSegments.begin(), spilledSegments.end());
+		spilledSegments.clear();
+	}
+	else if( readOffset == SPILL_SEGMENT_FRAMES )
+	{
+		freeSegments.push_back(spilledSegments.front());
+		spilledSegments.pop_front();
+		readOffset = 0;
+	}
+
+	return true;
+}
+
+bool spillQueue::pop(sensorFrame &frame)
+{
+	boost::lock_guard<boost::mutex> lock(spillMutex);
+	return popFrame(frame);
+}
+
+size_t spillQueue::popBulk(sensorFrameHeader *headers, sensorRecord *sensors, size_t maxFrames)
+{
+	boost::lock_guard<boost::mutex> lock(spillMutex);
+	size_t count = 0;
+
+	while( count != maxFrames && popFrame(bulkFrame) )
+	{
+		headers[count] = bulkFrame.header;
+		if( numSensors > 0 ) std::memcpy(sensors + count * numSensors, &bulkFrame.sensors[0], numSensors * sizeof(sensorRecord));
+		++count;
+	}
+
+	return count;
+}
+
+void spillQueue::getStatistics(spillStatistics &statistics) const
+{
+	boost::lock_guard<boost::mutex> lock(spillMutex);
+
+	statistics.memoryFrames = memory.read_available();
+	statistics.memoryCapacity = memory.getCapacity();
+	statistics.spilledFrames = spilledFrames;
+	statistics.fileSegments = fileSegments;
+	statistics.fileBytes = boost::uint64_t( fileSegments ) * segmentBytes;
+	statistics.totalSpilled = totalSpilled;
+	statistics.lostFrames = lostFrames;
+}
@@ -0,0 +1,93 @@
+/*
+	Frame queue for a consumer that may stall for a long time.  Frames
+	are held in memory until that fills, then written to segments of
+	a memory-mapped file and read back in order as the consumer catches
+	up, so nothing is lost however far it falls behind.  Only the
+	memory part and the two mapped segments being written and read use
+	RAM; segments the consumer has finished are reused.
+*/
+
+#include "sensorFrame.h"
+#include "frameRing.h"
+#include <boost/thread.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <deque>
+#include <string>
+#include <vector>
+
+#pragma once
+
+// Frames in each segment of the spill file
+const size_t SPILL_SEGMENT_FRAMES = 4096;
+
+// Where the queued frames are
+typedef struct spillStatisticsStruct
+{
+	size_t memoryFrames;			// Queued in memory
+	size_t memoryCapacity;
+	size_t spilledFrames;			// Queued in the file
+	size_t fileSegments;			// Segments the file has grown to
+	boost::uint64_t fileBytes;
+	unsigned long totalSpilled;		// Frames ever written to the file
+	unsigned long lostFrames;		// Frames that could be put neither in memory nor in the file, or were still queued at close
+} spillStatistics;
+
+class spillQueue
+{
+
+public:
+	explicit spillQueue(size_t memoryFrames);
+	~spillQueue();
+
+	// The file is created or emptied. Without a file frames past the memory part are lost. Only call while neither side is running
+	bool open(const std::string &spillFile);
+
+	// Empties the queue, the frames still in it count as lost. Only call while neither side is running
+	void close();
+	bool isOpen() const;
+
+	// Size for numSensors and empty the queue. Only call while neither side is running
+	void configure(int numSensors);
+
+	// One producer and one consumer, either may be on any thread
+	bool push(const sensorFrameView &view);
+	bool pop(sensorFrame &frame);
+	size_t popBulk(sensorFrameHeader *headers, sensorRecord *sensors, size_t maxFrames);
+
+	void getStatistics(spillStatistics &statistics) const;
+
+private:
+	bool popFrame(sensorFrame &frame);
+	bool startSegment();
+	bool growFile(size_t segments);
+	bool mapSegment(boost::interprocess::mapped_region &region, size_t &regionSegment, size_t segment);
+
+	frameRing memory;
+	int numSensors;
+	size_t slotBytes;					// Frame size in the file, in whole 8 byte words
+	size_t segmentBytes;
+
+	std::string fileName;
+	boost::interprocess::file_mapping file;
+	boost::interprocess::mapped_region writeRegion;
+	boost::interprocess::mapped_region readRegion;
+	size_t writeRegionSegment;			// Segment each region maps, or NO_SEGMENT
+	size_t readRegionSegment;
+
+	std::deque<size_t> spilledSegments;	// Oldest first, the consumer reads the front and the producer writes the back
+	std::vector<size_t> freeSegments;
+	size_t fileSegments;
+	size_t writeOffset;					// Frames written to the back segment
+	size_t readOffset;					// Frames read from the front segment
+	size_t spilledFrames;
+
+	unsigned long totalSpilled;
+	unsigned long lostFrames;
+
+	// Scratch for popBulk
+	sensorFrame bulkFrame;
+
+	mutable boost::mutex spillMutex;
+};
@@ -0,0 +1,146 @@
+#include "threadPolicy.h"
+#include <cstring>
+#include <sstream>
+
+#if defined WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <errno.h>
+#include <sys/mman.h>
+#endif
+
+// Amount of stack to touch, enough for the deepest tracking call chain
+const size_t PREFAULT_STACK_SIZE = 64 * 1024;
+
+void defaultThreadPolicy(threadPolicy &policy)
+{
+	policy.trackingScheduling = SCHEDULING_DEFAULT;
+	policy.trackingPriority = 0;
+	policy.trackingCpu = -1;
+
+	policy.loggingScheduling = SCHEDULING_DEFAULT;
+	policy.loggingPriority = 0;
+	policy.loggingCpu = -1;
+
+	policy.lockMemory = false;
+}
+
+bool setCurrentThreadScheduling(threadScheduling scheduling, int priority, std::string &report)
+{
+	std::ostringstream result;
+
+	if( scheduling == SCHEDULING_DEFAULT ) return true;
+
+#if defined WIN32
+	// Windows has no FIFO/RR distinction, both map onto the time critical priority
+	if( !SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) )
+	{
+		result << "Scheduling: SetThreadPriority failed (" << GetLastError() << "), using default priority" << std::endl;
+		report += result.str();
+		return false;
+	}
+
+	result << "Scheduling: THREAD_PRIORITY_TIME_CRITICAL" << std::endl;
+#else
+	int policy = ( scheduling == SCHEDULING_FIFO ) ? SCHED_FIFO : SCHED_RR;
+
+	sched_param parameters;
+	std::memset(&parameters, 0, sizeof(parameters));
+	parameters.sched_priority = priority;
+
+	// Keep the priority in the range the OS allows
+	if( parameters.sched_priority < sched_get_priority_min(policy) ) parameters.sched_priority = sched_get_priority_min(policy);
+	if( parameters.sched_priority > sched_get_priority_max(policy) ) parameters.sched_priority = sched_get_priority_max(policy);
+
+	int error = pthread_setschedparam(pthread_self(), policy, &parameters);
+	if( error != 0 )
+	{
+		result << "Scheduling: " << ( policy == SCHED_FIFO ? "SCHED_FIFO" : "SCHED_RR" ) << " failed (" << std::strerror(error) << ")";
+		if( error == EPERM ) result << ", needs CAP_SYS_NICE or an rtprio limit";
+		result << ", using default scheduling" << std::endl;
+		report += result.str();
+		return false;
+	}
+
+	result << "Scheduling: " << ( policy == SCHED_FIFO ? "SCHED_FIFO" : "SCHED_RR" ) << " priority " << parameters.sched_priority << std::endl;
+#endif
+
+	report += result.str();
+	return true;
+}
+
+bool setCurrentThreadAffinity(int cpu, std::string &report)
+{
+	std::ostringstream result;
+
+	if( cpu < 0 ) return true;
+
+#if defined WIN32
+	if( cpu >= int(sizeof(DWORD_PTR) * 8) || !SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) )
+	{
+		result << "Affinity: CPU " << cpu << " failed (" << GetLastError() << "), not pinned" << std::endl;
+		report += result.str();
+		return false;
+	}
+#elif defined __linux__
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+	CPU_SET(cpu, &cpuSet);
+
+	int error = pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+	if( error != 0 )
+	{
+		result << "Affinity: CPU " << cpu << " failed (" << std::strerror(error) << "), not pinned" << std::endl;
+		report += result.str();
+		return false;
+	}
+#else
+	result << "Affinity: not supported on this platform, not pinned" << std::endl;
+	report += result.str();
+	return false;
+#endif
+
+	result << "Affinity: CPU " << cpu << std::endl;
+	report += result.str();
+	return true;
+}
+
+void prefaultCurrentThreadStack()
+{
+	// Written through a volatile pointer so the stores aren't optimised away
+	unsigned char stackTouch[PREFAULT_STACK_SIZE];
+	volatile unsigned char *touch = stackTouch;
+
+	for( size_t i = 0; i < PREFAULT_STACK_SIZE; i += 256 )
+	{
+		touch[i] = 0;
+	}
+}
+
+bool lockProcessMemory(std::string &report)
+{
+	std::ostringstream result;
+
+#if defined WIN32
+	// No mlockall on Windows, the buffers are still pre-faulted
+	result << "Memory: locking not supported on Windows, buffers pre-faulted only" << std::endl;
+	report += result.str();
+	return false;
+#else
+	if( mlockall(MCL_CURRENT | MCL_FUTURE) != 0 )
+	{
+		int error = errno;
+		result << "Memory: mlockall failed (" << std::strerror(error) << ")";
+		if( error == EPERM || error == ENOMEM ) result << ", needs CAP_IPC_LOCK or a larger memlock limit";
+		result << ", buffers pre-faulted only" << std::endl;
+		report += result.str();
+		return false;
+	}
+
+	result << "Memory: locked" << std::endl;
+	report += result.str();
+	return true;
+#endif
+}
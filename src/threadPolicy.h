@@ -0,0 +1,57 @@
+/*
+	Real-time scheduling, CPU affinity and memory locking for the
+	acquisition threads.  Each call applies to the calling thread, or
+	the whole process for the memory lock, and returns false rather
+	than failing hard when the platform or the process privileges
+	don't allow it.
+*/
+
+#include <string>
+
+#pragma once
+
+// Scheduling class for a thread
+enum threadScheduling
+{
+	SCHEDULING_DEFAULT,		// Leave the thread as the OS created it
+	SCHEDULING_FIFO,		// Real-time, runs until it blocks (SCHED_FIFO)
+	SCHEDULING_RR			// Real-time, round robin between equal priorities (SCHED_RR)
+};
+
+// Requested policy for the tracking and logging threads
+typedef struct threadPolicyStruct
+{
+	threadScheduling trackingScheduling;
+	int trackingPriority;		// 1 (lowest) to 99 (highest) real-time priority
+	int trackingCpu;			// CPU to pin the thread to, -1 for no affinity
+
+	threadScheduling loggingScheduling;
+	int loggingPriority;
+	int loggingCpu;
+
+	bool lockMemory;			// mlockall and pre-fault the buffers before the threads start
+} threadPolicy;
+
+// What could actually be applied
+typedef struct appliedThreadPolicyStruct
+{
+	bool trackingScheduling;
+	bool trackingAffinity;
+	bool loggingScheduling;
+	bool loggingAffinity;
+	bool memoryLocked;
+	std::string report;			// One line per setting, including why anything failed
+} appliedThreadPolicy;
+
+// Fill out a policy that leaves everything at the OS defaults
+void defaultThreadPolicy(threadPolicy &policy);
+
+// Apply to the calling thread, a description of the result is appended to report
+bool setCurrentThreadScheduling(threadScheduling scheduling, int priority, std::string &report);
+bool setCurrentThreadAffinity(int cpu, std::string &report);
+
+// Touch the pages of the calling thread's stack so they are resident before time critical work
+void prefaultCurrentThreadStack();
+
+// Lock all current and future pages of the process in memory
+bool lockProcessMemory(std::string &report);
@@ -0,0 +1,142 @@
+#include "windowedStatistics.h"
+#include <cmath>
+
+// Values kept for each sensor
+static const int CHANNELS_PER_SENSOR = 4;
+
+windowedStatistics::windowedStatistics()
+{
+	configure(0, DEFAULT_STATISTICS_WINDOW);
+}
+
+void windowedStatistics::configure(int numSensors, unsigned int window)
+{
+	this->numSensors = numSensors;
+	this->window = window < 1 ? 1 : window;
+
+	// All the allocation happens here
+	channels.assign(numSensors * CHANNELS_PER_SENSOR, slidingChannel());
+	for( size_t i = 0; i != channels.size(); ++i )
+	{
+		slidingChannel &channel = channels[i];
+		channel.mean = 0.0;
+		channel.m2 = 0.0;
+		channel.values.assign(this->window, 0.0);
+		channel.minimumQueue.assign(this->window, 0);
+		channel.maximumQueue.assign(this->window, 0);
+		channel.minimumHead = channel.minimumTail = 0;
+		channel.maximumHead = channel.maximumTail = 0;
+	}
+
+	sequences.assign(numSensors, 0);
+
+	sensorStatistics empty = sensorStatistics();
+	published.assign(numSensors, empty);
+	lock.reset();
+}
+
+unsigned int windowedStatistics::getWindow() const
+{
+	return window;
+}
+
+void windowedStatistics::addSample(slidingChannel &channel, boost::uint64_t sequence, double value)
+{
+	size_t slot = size_t( sequence % window );
+
+	// Take out the sample leaving the window, it sits in the slot the new one goes in
+	if( sequence >= window )
+	{
+		double oldest = channel.values[slot];
+		double remaining = double( window - 1 );
+
+		if( remaining > 0.0 )
+		{
+			double delta = oldest - channel.mean;
+			channel.mean -= delta / remaining;
+			channel.m2 -= delta * ( oldest - channel.mean );
+			if( channel.m2 < 0.0 ) channel.m2 = 0.0;
+		}
+		else
+		{
+			channel.mean = 0.0;
+			channel.m2 = 0.0;
+		}
+
+		// And out of the queues, before its value is overwritten
+		if( channel.minimumTail != channel.minimumHead && channel.minimumQueue[size_t( channel.minimumHead % window )] == sequence - window ) ++channel.minimumHead;
+		if( channel.maximumTail != channel.maximumHead && channel.maximumQueue[size_t( channel.maximumHead % window )] == sequence - window ) ++channel.maximumHead;
+	}
+
+	channel.values[slot] = value;
+
+	// Welford
+	double count = double( sequence >= window ? window : sequence + 1 );
+	double delta = value - channel.mean;
+	channel.mean += delta / count;
+	channel.m2 += delta * ( value - channel.mean );
+
+	// Anything the new value beats can never be the minimum or maximum again
+	while( channel.minimumTail != channel.minimumHead && channel.values[size_t( channel.minimumQueue[size_t( ( channel.minimumTail - 1 ) % window )] % window )] >= value ) --channel.minimumTail;
+	channel.minimumQueue[size_t( channel.minimumTail++ % window )] = sequence;
+
+	while( channel.maximumTail != channel.maximumHead && channel.values[size_t( channel.maximumQueue[size_t( ( channel.maximumTail - 1 ) % window )] % window )] <= value ) --channel.maximumTail;
+	channel.maximumQueue[size_t( channel.maximumTail++ % window )] = sequence;
+}
+
+void windowedStatistics::summarise(const slidingChannel &channel, unsigned int samples, channelStatistics &statistics) const
+{
+	statistics.mean = channel.mean;
+	statistics.variance = samples > 0 ? channel.m2 / samples : 0.0;
+	statistics.minimum = channel.values[size_t( channel.minimumQueue[size_t( channel.minimumHead % window )] % window )];
+	statistics.maximum = channel.values[size_t( channel.maximumQueue[size_t( channel.maximumHead % window )] % window )];
+	statistics.peakToPeak = statistics.maximum - statistics.minimum;
+}
+
+void windowedStatistics::addFrame(const sensorFrameHeader &header, const sensorRecord *sensors)
+{
+	int slots = header.numSensors < numSensors ? header.numSensors : numSensors;
+
+	lock.writeBegin();
+
+	for( int i = 0; i != slots; ++i )
+	{
+		const sensorRecord &sensor = sensors[i];
+
+		if( ( sensor.status & SENSOR_NO_POSE_BITS ) || sensor.translation.x < MAX_NEGATIVE ) continue;
+
+		slidingChannel *channel = &channels[i * CHANNELS_PER_SENSOR];
+		boost::uint64_t sequence = sequences[i]++;
+
+		addSample(channel[0], sequence, sensor.translation.x);
+		addSample(channel[1], sequence, sensor.translation.y);
+		addSample(channel[2], sequence, sensor.translation.z);
+		addSample(channel[3], sequence, sensor.error);
+
+		sensorStatistics &statistics = published[i];
+		statistics.samples = (unsigned int)( sequence + 1 >= window ? window : sequence + 1 );
+		summarise(channel[0], statistics.samples, statistics.x);
+		summarise(channel[1], statistics.samples, statistics.y);
+		summarise(channel[2], statistics.samples, statistics.z);
+		summarise(channel[3], statistics.samples, statistics.error);
+		statistics.errorRms = std::sqrt(statistics.error.mean * statistics.error.mean + statistics.error.variance);
+	}
+
+	lock.writeEnd();
+}
+
+bool windowedStatistics::getStatistics(int slot, sensorStatistics &statistics) const
+{
+	boost::uint64_t begin;
+	bool found;
+
+	do
+	{
+		begin = lock.readBegin();
+		found = slot >= 0 && slot < numSensors && published[slot].samples > 0;
+		if( found ) statistics = published[slot];
+	}
+	while( lock.readRetry(begin) );
+
+	return found;
+}
@@ -0,0 +1,81 @@
+/*
+	Statistics of each sensor over a sliding window of its last
+	poses: the mean, variance and range of each position axis and of
+	the RMS error.  Each frame updates the running mean and variance
+	by adding the new sample and removing the one leaving the window,
+	and the range from monotonic queues of the window's minima and
+	maxima, so the cost per frame doesn't depend on the window size.
+	The results are published under a sequence lock for readers.
+*/
+
+#include "sensorFrame.h"
+#include "seqLock.h"
+#include <boost/cstdint.hpp>
+#include <vector>
+
+#pragma once
+
+// Window used until another is set, about 5 s at 40 Hz
+const unsigned int DEFAULT_STATISTICS_WINDOW = 200;
+
+// Statistics of one value over the window
+typedef struct channelStatisticsStruct
+{
+	double mean;
+	double variance;		// Of the population in the window
+	double minimum;
+	double maximum;
+	double peakToPeak;
+} channelStatistics;
+
+// Statistics of one sensor
+typedef struct sensorStatisticsStruct
+{
+	unsigned int samples;		// Poses in the window, frames with no pose aren't counted
+	channelStatistics x;		// mm
+	channelStatistics y;
+	channelStatistics z;
+	channelStatistics error;	// The Aurora's RMS error of each pose
+	double errorRms;			// RMS of that over the window
+} sensorStatistics;
+
+class windowedStatistics
+{
+
+public:
+	windowedStatistics();
+
+	// Size for numSensors and a window of that many poses, and clear everything. Only call while nothing is adding frames
+	void configure(int numSensors, unsigned int window);
+	unsigned int getWindow() const;
+
+	// Post-processing stage only, one frame at a time in frame order
+	void addFrame(const sensorFrameHeader &header, const sensorRecord *sensors);
+
+	// Any thread, returns false if the sensor has no poses in the window
+	bool getStatistics(int slot, sensorStatistics &statistics) const;
+
+private:
+	// One value of one sensor
+	typedef struct slidingChannelStruct
+	{
+		double mean;
+		double m2;							// Sum of squared differences from the mean
+		std::vector<double> values;			// Sample with sequence s is at s % window
+		std::vector<boost::uint64_t> minimumQueue;	// Sequences with increasing values, oldest first
+		std::vector<boost::uint64_t> maximumQueue;	// Sequences with decreasing values, oldest first
+		boost::uint64_t minimumHead, minimumTail;
+		boost::uint64_t maximumHead, maximumTail;
+	} slidingChannel;
+
+	void addSample(slidingChannel &channel, boost::uint64_t sequence, double value);
+	void summarise(const slidingChannel &channel, unsigned int samples, channelStatistics &statistics) const;
+
+	int numSensors;
+	unsigned int window;
+	std::vector<slidingChannel> channels;			// x, y, z and error of each sensor
+	std::vector<boost::uint64_t> sequences;			// Poses ever added for each sensor
+
+	std::vector<sensorStatistics> published;
+	seqLock lock;
+};